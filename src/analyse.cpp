@@ -0,0 +1,190 @@
+#include "pch.h"
+#include "analyse.h"
+#include "position.h"
+#include "search.h"
+#include "tt.h"
+#include "uci.h"
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Zugzwang {
+
+namespace Analyse {
+
+namespace {
+
+// Puts the results back in input order. Workers do not start on a position more than the
+// buffer size ahead of the next one to print, which bounds the memory a slow position can hold.
+class ReorderBuffer {
+  public:
+    explicit ReorderBuffer(size_t capacity) : slots(capacity) {}
+
+    // Blocks until the result of position 'index' has a slot
+    void WaitForRoom(size_t index) {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [&] { return index < next + slots.size(); });
+    }
+
+    void Put(size_t index, std::string line) {
+        {
+            std::lock_guard lock(mutex);
+            Slot& slot = slots[index % slots.size()];
+            slot.line = std::move(line);
+            slot.ready = true;
+        }
+        changed.notify_all();
+    }
+
+    // Prints the results in order as they arrive, until 'count' of them are out
+    void Drain(size_t count, std::ostream& os) {
+        std::unique_lock lock(mutex);
+        while (next < count) {
+            Slot& slot = slots[next % slots.size()];
+            changed.wait(lock, [&] { return slot.ready; });
+
+            const std::string line = std::move(slot.line);
+            slot.ready = false;
+            ++next;
+
+            lock.unlock();
+            changed.notify_all();
+            os << line << '\n';
+            lock.lock();
+        }
+        os << std::flush;
+    }
+
+  private:
+    struct Slot {
+        std::string line;
+        bool ready = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t next = 0; // the position whose result is printed next
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+class Worker {
+  public:
+    Worker(const Search::Limits& searchLimits, int hashMB) : limits(searchLimits) {
+        if (!tt.Resize(hashMB)) {
+            tt.Resize(1);
+        }
+    }
+
+    // Every position starts from an empty table, so a result does not depend on which thread
+    // searched what before it
+    std::string Process(std::string_view line, uint64_t& nodes) {
+        const std::string_view fen = FenFields(line);
+        if (!pos.ParseFen(fen)) {
+            return std::string(line) + " ; error invalid FEN";
+        }
+
+        tt.Clear();
+        searcher.Clear();
+        const auto& rootMoves = searcher.Run(pos, limits, 1, nullptr);
+        nodes = searcher.Nodes();
+
+        std::string result(fen);
+        if (rootMoves.empty()) {
+            result += " ; bm 0000 ; score ";
+            result += pos.Checkers() ? "mate 0" : "cp 0";
+        } else {
+            result += " ; bm " + UCI::FormatMove(rootMoves[0].pv[0]);
+            result += " ; score " + UCI::FormatScore(rootMoves[0].score);
+        }
+        return result + " ; nodes " + std::to_string(nodes);
+    }
+
+  private:
+    const Search::Limits& limits;
+    Position pos;
+    TranspositionTable tt;
+    Search::Worker searcher{ tt };
+};
+
+} // namespace
+
+std::string_view FenFields(std::string_view line) {
+    size_t end = 0;
+    for (int fields = 0; fields < 6; ++fields) {
+        const size_t start = line.find_first_not_of(' ', end);
+        if (start == std::string_view::npos || (fields >= 4 && !std::isdigit(line[start]))) {
+            break;
+        }
+        end = std::min(line.find(' ', start), line.size());
+    }
+    return line.substr(0, end);
+}
+
+void Run(const Options& options) {
+    using namespace std::chrono;
+
+    std::ifstream in(options.input);
+    if (!in) {
+        std::cout << "Unable to open '" << options.input << "'\n";
+        return;
+    }
+
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] != '#') {
+            lines.push_back(std::move(line));
+        }
+    }
+
+    Search::Limits limits;
+    limits.depth = options.depth;
+    limits.nodes = options.nodes;
+    if (!limits.depth && !limits.nodes) {
+        limits.depth = 8;
+    }
+
+    const int threadCount = std::max(options.threads, 1);
+    ReorderBuffer buffer(std::max<size_t>(16, 4 * threadCount));
+    std::atomic<size_t> nextIndex{ 0 };
+    std::atomic<uint64_t> totalNodes{ 0 };
+
+    const auto start = steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&] {
+            // A Worker holds a whole Position, keep it off the thread's stack
+            auto worker = std::make_unique<Worker>(limits, options.hashMB);
+
+            for (size_t index; (index = nextIndex.fetch_add(1)) < lines.size();) {
+                buffer.WaitForRoom(index);
+
+                uint64_t nodes = 0;
+                buffer.Put(index, worker->Process(lines[index], nodes));
+                totalNodes.fetch_add(nodes, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    buffer.Drain(lines.size(), std::cout);
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+    std::cout << "Analysed " << lines.size() << " positions in " << uint64_t(secs * 1000)
+              << " ms on " << threadCount << " threads: " << std::fixed << std::setprecision(1)
+              << lines.size() / secs << " positions/sec, " << std::defaultfloat
+              << uint64_t(totalNodes.load() / secs) << " nodes/sec\n";
+}
+
+} // namespace Analyse
+
+} // namespace Zugzwang
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Zugzwang {
+
+namespace Analyse {
+
+struct Options {
+    std::string input;
+    int depth = 0;      // the search stops at whichever of depth and nodes comes first,
+    uint64_t nodes = 0; // with depth 8 when neither is given
+    int threads = 1;
+    int hashMB = 16; // transposition table of each thread
+};
+
+// EPD lines have the four board fields of a FEN followed by operations such as "bm e4;", FEN
+// lines may add the two clocks. Returns the part Position::ParseFen() understands.
+std::string_view FenFields(std::string_view line);
+
+// Searches every position of an EPD or FEN file independently, spread over 'threads' threads
+// that each own a Position, a Search::Worker and a table. Prints "<fen> ; bm <move> ; score
+// <score> ; nodes <n>" per position in input order, then the positions/sec of the whole run.
+void Run(const Options& options);
+
+} // namespace Analyse
+
+} // namespace Zugzwang
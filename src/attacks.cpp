@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "attacks.h"
+#include "position.h"
+
+namespace Zugzwang {
+
+namespace {
+
+template <Color Us, PieceType Pt>
+void addPieceAttacks(const Position& pos, AttackInfo& ai) {
+    const Bitboard occupied = pos.Pieces();
+    const Bitboard theirZone = ai.kingZone[~Us];
+
+    Bitboard bb = pos.Pieces(Us, Pt);
+    while (bb) {
+        const Square sq = PopLsb(bb);
+        // The king zone already holds the king's attacks
+        const Bitboard attacks = Pt == KING ? ai.kingZone[Us] ^ sq
+                                            : Bitboards::GetAttacks<Pt>(sq, occupied);
+
+        ai.byPiece[sq] = attacks;
+        ai.byType[Us][Pt] |= attacks;
+        ai.doubled[Us] |= ai.byType[Us][ALL_PIECES] & attacks;
+        ai.byType[Us][ALL_PIECES] |= attacks;
+        ai.kingZoneAttacks[~Us] += Popcount(attacks & theirZone);
+    }
+}
+
+template <Color Us>
+void addAttacks(const Position& pos, AttackInfo& ai) {
+    constexpr Direction UpLeft = Us == WHITE ? NORTH_WEST : SOUTH_EAST;
+    constexpr Direction UpRight = Us == WHITE ? NORTH_EAST : SOUTH_WEST;
+
+    // Pawns go set-wise, as in the generator, so they have no byPiece entries
+    const Bitboard pawns = pos.Pieces(Us, PAWN);
+    const Bitboard left = Shift<UpLeft>(pawns);
+    const Bitboard right = Shift<UpRight>(pawns);
+
+    ai.byType[Us][PAWN] = left | right;
+    ai.byType[Us][ALL_PIECES] = left | right;
+    ai.doubled[Us] = left & right;
+    ai.kingZoneAttacks[~Us] = Popcount(left & ai.kingZone[~Us]) +
+                              Popcount(right & ai.kingZone[~Us]);
+
+    addPieceAttacks<Us, KNIGHT>(pos, ai);
+    addPieceAttacks<Us, BISHOP>(pos, ai);
+    addPieceAttacks<Us, ROOK>(pos, ai);
+    addPieceAttacks<Us, QUEEN>(pos, ai);
+    addPieceAttacks<Us, KING>(pos, ai);
+}
+
+} // namespace
+
+void AttackInfo::Compute(const Position& pos) {
+    for (Color c : { WHITE, BLACK }) {
+        const Square ksq = pos.square<KING>(c);
+        kingZone[c] = Bitboards::GetAttacks<KING>(ksq) | ksq;
+
+        for (PieceType pt = KNIGHT; pt <= KING; ++pt) {
+            byType[c][pt] = 0;
+        }
+    }
+
+    addAttacks<WHITE>(pos, *this);
+    addAttacks<BLACK>(pos, *this);
+}
+
+} // namespace Zugzwang
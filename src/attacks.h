@@ -0,0 +1,21 @@
+#pragma once
+
+#include "types.h"
+
+namespace Zugzwang {
+
+class Position;
+
+// Every attacked square of a position, gathered in one pass over the pieces so that the
+// evaluation and the move generators of a node share the GetAttacks() lookups
+struct AttackInfo {
+    void Compute(const Position& pos);
+
+    Bitboard byPiece[SQUARE_NB];              // of the knight, slider or king on each square
+    Bitboard byType[COLOR_NB][PIECE_TYPE_NB]; // [c][ALL_PIECES] is everything c attacks
+    Bitboard doubled[COLOR_NB];               // squares c attacks at least twice
+    Bitboard kingZone[COLOR_NB];              // the king of c and its neighbouring squares
+    int kingZoneAttacks[COLOR_NB];            // attacks on that zone by the other side
+};
+
+} // namespace Zugzwang
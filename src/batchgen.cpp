@@ -0,0 +1,295 @@
+#include "pch.h"
+#include "batchgen.h"
+#include "bitboard.h"
+#include "position.h"
+
+namespace Zugzwang {
+
+namespace BatchGen {
+
+namespace {
+
+constexpr Bitboard CastlingEmpty[CASTLING_RIGHT_NB] = { 0, SQ_F1 | SQ_G1, SQ_B1 | SQ_C1 | SQ_D1, 0,
+    SQ_F8 | SQ_G8, 0, 0, 0, SQ_B8 | SQ_C8 | SQ_D8 };
+constexpr Bitboard CastlingSafe[CASTLING_RIGHT_NB] = { 0, SQ_E1 | SQ_F1, SQ_E1 | SQ_D1, 0,
+    SQ_E8 | SQ_F8, 0, 0, 0, SQ_E8 | SQ_D8 };
+
+// Moves of the pawn set of one color, with every promotion counting as four moves
+template <Color Us, typename T>
+T pawnMoveCount(T pawns, T empty, T enemies, T ep, T (*popcount)(T)) {
+    constexpr Bitboard notA = ~FileABB, notH = ~FileHBB;
+    constexpr Bitboard promo = Us == WHITE ? Rank8BB : Rank1BB;
+    constexpr Bitboard third = Us == WHITE ? Rank3BB : Rank6BB;
+
+    const T push = (Us == WHITE ? pawns << 8 : pawns >> 8) & empty;
+    const T push2 = (Us == WHITE ? (push & third) << 8 : (push & third) >> 8) & empty;
+    const T west = Us == WHITE ? (pawns << 7) & notH : (pawns >> 9) & notH;
+    const T east = Us == WHITE ? (pawns << 9) & notA : (pawns >> 7) & notA;
+
+    return popcount(push & ~promo) + 4 * popcount(push & promo) + popcount(push2) +
+        popcount(west & enemies & ~promo) + 4 * popcount(west & enemies & promo) +
+        popcount(east & enemies & ~promo) + 4 * popcount(east & enemies & promo) +
+        popcount(west & ep) + popcount(east & ep);
+}
+
+uint64_t popcountScalar(uint64_t b) { return uint64_t(Popcount(b)); }
+
+template <Color Us>
+Bitboard pawnAttacks(Bitboard pawns) {
+    return Us == WHITE ? ((pawns << 7) & ~FileHBB) | ((pawns << 9) & ~FileABB)
+                       : ((pawns >> 9) & ~FileHBB) | ((pawns >> 7) & ~FileABB);
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+// GCC vector extensions, compiled to AVX2 or AVX-512 instructions depending on -march
+using V = uint64_t __attribute__((vector_size(Lanes * sizeof(uint64_t))));
+
+V load(const Bitboard* p) {
+    V v;
+    std::memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+void store(Bitboard* p, V v) { std::memcpy(p, &v, sizeof(V)); }
+
+// All ones in the lanes where x is zero
+V isZero(V x) { return V(x == 0); }
+
+// SWAR population count, AVX2 and AVX-512F have no 64-bit popcount instruction
+V popcount(V x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x += x >> 8;
+    x += x >> 16;
+    x += x >> 32;
+    return x & 0x7F;
+}
+
+template <int D>
+V shift(V b) {
+    if constexpr (D > 0) {
+        return b << D;
+    } else {
+        return b >> -D;
+    }
+}
+
+// Squares a piece moving in direction D could wrap around from
+template <int D>
+constexpr Bitboard wrapMask() {
+    constexpr int file = ((D % 8) + 8) % 8; // EAST component as 1, WEST as 7
+    return file == 1 ? ~FileABB : file == 7 ? ~FileHBB : ~0ULL;
+}
+
+// Kogge-Stone occluded fill: the generators spread in direction D over the propagator squares
+template <int D>
+V occludedFill(V gen, V pro) {
+    pro &= wrapMask<D>();
+    gen |= pro & shift<D>(gen);
+    pro &= shift<D>(pro);
+    gen |= pro & shift<2 * D>(gen);
+    pro &= shift<2 * D>(pro);
+    gen |= pro & shift<4 * D>(gen);
+    return gen;
+}
+
+// Squares attacked in direction D by the sliders, blocked by the first occupied square
+template <int D>
+V slide(V sliders, V empty) {
+    return shift<D>(occludedFill<D>(sliders, empty)) & wrapMask<D>();
+}
+
+template <int D>
+V step(V pieces) {
+    return shift<D>(pieces) & wrapMask<D>();
+}
+
+// Knight jumps, masking out the files a jump could wrap around from
+template <int D>
+V jump(V knights) {
+    constexpr int file = ((D % 8) + 8) % 8;
+    constexpr Bitboard mask = file == 1 ? ~FileABB
+        : file == 2                     ? ~(FileABB | FileBBB)
+        : file == 6                     ? ~(FileGBB | FileHBB)
+                                        : ~FileHBB;
+    return shift<D>(knights) & mask;
+}
+
+// Accumulates attacks in 'att' and, for the side to move, the number of moves in 'count'.
+// Every square reached in one direction comes from a single piece because the first
+// friendly piece on a ray blocks it, so counting per direction counts moves exactly.
+struct Accumulator {
+    V att[COLOR_NB] = {};
+    V count = {};
+    V notOwn[COLOR_NB];
+    V stm; // all ones in lanes where black is to move
+
+    void Add(V white, V black) {
+        att[WHITE] |= white;
+        att[BLACK] |= black;
+        count += popcount((white & notOwn[WHITE] & ~stm) | (black & notOwn[BLACK] & stm));
+    }
+};
+
+template <int... Ds>
+void addSliders(Accumulator& acc, V white, V black, V empty) {
+    (acc.Add(slide<Ds>(white, empty), slide<Ds>(black, empty)), ...);
+}
+
+template <int... Ds>
+void addJumps(Accumulator& acc, V white, V black) {
+    (acc.Add(jump<Ds>(white), jump<Ds>(black)), ...);
+}
+
+template <int... Ds>
+void addSteps(Accumulator& acc, V white, V black) {
+    (acc.Add(step<Ds>(white), step<Ds>(black)), ...);
+}
+
+void analyseLanes(const PositionBlock& block, int first, BlockResult& result) {
+    const V white = load(&block.byColor[WHITE][first]);
+    const V black = load(&block.byColor[BLACK][first]);
+    const V pawns = load(&block.byType[PAWN][first]);
+    const V knights = load(&block.byType[KNIGHT][first]);
+    const V bishops = load(&block.byType[BISHOP][first]);
+    const V rooks = load(&block.byType[ROOK][first]);
+    const V queens = load(&block.byType[QUEEN][first]);
+    const V kings = load(&block.byType[KING][first]);
+    const V ep = load(&block.epSquare[first]);
+    const V empty = ~(white | black);
+
+    V stm, castling;
+    for (int l = 0; l < Lanes; ++l) {
+        stm[l] = block.sideToMove[first + l] == BLACK ? ~0ULL : 0;
+        castling[l] = block.castlingRights[first + l];
+    }
+
+    Accumulator acc;
+    acc.notOwn[WHITE] = ~white;
+    acc.notOwn[BLACK] = ~black;
+    acc.stm = stm;
+
+    const V diagonal = bishops | queens, orthogonal = rooks | queens;
+    addSliders<NORTH_EAST, NORTH_WEST, SOUTH_EAST, SOUTH_WEST>(
+        acc, diagonal & white, diagonal & black, empty);
+    addSliders<NORTH, SOUTH, EAST, WEST>(acc, orthogonal & white, orthogonal & black, empty);
+    addJumps<17, 15, 10, 6, -6, -10, -15, -17>(acc, knights & white, knights & black);
+    addSteps<NORTH, SOUTH, EAST, WEST, NORTH_EAST, NORTH_WEST, SOUTH_EAST, SOUTH_WEST>(
+        acc, kings & white, kings & black);
+
+    // Pawn attacks only count towards the attack maps, captures are counted below
+    const V whitePawns = pawns & white, blackPawns = pawns & black;
+    acc.att[WHITE] |= ((whitePawns << 7) & ~FileHBB) | ((whitePawns << 9) & ~FileABB);
+    acc.att[BLACK] |= ((blackPawns >> 9) & ~FileHBB) | ((blackPawns >> 7) & ~FileABB);
+
+    V count = acc.count;
+    count += pawnMoveCount<WHITE, V>(whitePawns & ~stm, empty, black, ep, popcount);
+    count += pawnMoveCount<BLACK, V>(blackPawns & stm, empty, white, ep, popcount);
+
+    // Castling: the squares between king and rook empty, the king's path not attacked
+    const V occupied = ~empty;
+    for (CastlingRights cr : { WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO }) {
+        const V colorMask = cr & (WHITE_OO | WHITE_OOO) ? ~stm : stm;
+        const V enemyAttacks = cr & (WHITE_OO | WHITE_OOO) ? acc.att[BLACK] : acc.att[WHITE];
+        count += colorMask & ~isZero(castling & uint64_t(cr)) &
+            isZero(occupied & CastlingEmpty[cr]) & isZero(enemyAttacks & CastlingSafe[cr]) & 1;
+    }
+
+    const V enemyAttacks = (acc.att[BLACK] & ~stm) | (acc.att[WHITE] & stm);
+    const V inCheck = ~isZero(kings & ((white & ~stm) | (black & stm)) & enemyAttacks);
+
+    store(&result.attacks[WHITE][first], acc.att[WHITE]);
+    store(&result.attacks[BLACK][first], acc.att[BLACK]);
+    for (int l = 0; l < Lanes; ++l) {
+        result.moveCount[first + l] = uint16_t(count[l]);
+        result.inCheck[first + l] = inCheck[l] != 0;
+    }
+}
+
+#endif
+
+} // namespace
+
+void PositionBlock::Set(int i, const Position& pos) {
+    assert(i >= 0 && i < Size);
+
+    byColor[WHITE][i] = pos.Pieces(WHITE);
+    byColor[BLACK][i] = pos.Pieces(BLACK);
+    for (PieceType pt = ALL_PIECES; pt < PIECE_TYPE_NB; ++pt) {
+        byType[pt][i] = pt <= KING ? pos.Pieces(pt) : 0;
+    }
+
+    epSquare[i] = pos.EpSuare() == SQ_NONE ? 0 : SquareBb(pos.EpSuare());
+    sideToMove[i] = uint8_t(pos.SideToMove());
+
+    castlingRights[i] = 0;
+    for (CastlingRights cr : { WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO }) {
+        castlingRights[i] |= pos.CanCastle(cr) ? cr : 0;
+    }
+}
+
+void Analyse(const PositionBlock& block, BlockResult& result) {
+#if defined(__AVX512F__) || defined(__AVX2__)
+    // The last group of lanes may run past 'count', its extra results are simply ignored
+    for (int first = 0; first < block.count; first += Lanes) {
+        analyseLanes(block, first, result);
+    }
+#else
+    AnalyseScalar(block, result);
+#endif
+}
+
+void AnalyseScalar(const PositionBlock& block, BlockResult& result) {
+    for (int i = 0; i < block.count; ++i) {
+        const Bitboard occupied = block.byType[ALL_PIECES][i];
+        const Color us = Color(block.sideToMove[i]);
+        int count = 0;
+
+        for (Color c : { WHITE, BLACK }) {
+            const Bitboard own = block.byColor[c][i];
+            Bitboard attacks = 0;
+
+            auto addPieces = [&]<PieceType Pt>() {
+                for (Bitboard b = block.byType[Pt][i] & own; b;) {
+                    const Bitboard att = Bitboards::GetAttacks<Pt>(PopLsb(b), occupied);
+                    attacks |= att;
+                    count += c == us ? Popcount(att & ~own) : 0;
+                }
+            };
+            addPieces.template operator()<KNIGHT>();
+            addPieces.template operator()<BISHOP>();
+            addPieces.template operator()<ROOK>();
+            addPieces.template operator()<QUEEN>();
+            addPieces.template operator()<KING>();
+
+            const Bitboard pawns = block.byType[PAWN][i] & own;
+            attacks |= c == WHITE ? pawnAttacks<WHITE>(pawns) : pawnAttacks<BLACK>(pawns);
+            result.attacks[c][i] = attacks;
+        }
+
+        const Bitboard pawns = block.byType[PAWN][i] & block.byColor[us][i];
+        const Bitboard enemies = block.byColor[~us][i];
+        count += us == WHITE
+            ? int(pawnMoveCount<WHITE, uint64_t>(
+                  pawns, ~occupied, enemies, block.epSquare[i], popcountScalar))
+            : int(pawnMoveCount<BLACK, uint64_t>(
+                  pawns, ~occupied, enemies, block.epSquare[i], popcountScalar));
+
+        const CastlingRights oo = us == WHITE ? WHITE_OO : BLACK_OO;
+        const CastlingRights ooo = us == WHITE ? WHITE_OOO : BLACK_OOO;
+        for (CastlingRights cr : { oo, ooo }) {
+            count += (block.castlingRights[i] & cr) && !(occupied & CastlingEmpty[cr]) &&
+                !(result.attacks[~us][i] & CastlingSafe[cr]);
+        }
+
+        result.moveCount[i] = uint16_t(count);
+        result.inCheck[i] =
+            (block.byType[KING][i] & block.byColor[us][i] & result.attacks[~us][i]) != 0;
+    }
+}
+
+} // namespace BatchGen
+
+} // namespace Zugzwang
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.h"
+
+namespace Zugzwang {
+
+class Position;
+
+namespace BatchGen {
+
+// Structure-of-arrays block of independent positions
+struct PositionBlock {
+    static constexpr int Size = 64;
+
+    void Set(int i, const Position& pos);
+
+    alignas(64) Bitboard byColor[COLOR_NB][Size] = {};
+    alignas(64) Bitboard byType[PIECE_TYPE_NB][Size] = {};
+    alignas(64) Bitboard epSquare[Size] = {}; // 0 if there is no en passant square
+    uint8_t sideToMove[Size] = {};
+    uint8_t castlingRights[Size] = {};
+    int count = 0;
+};
+
+struct BlockResult {
+    alignas(64) Bitboard attacks[COLOR_NB][PositionBlock::Size];
+    uint16_t moveCount[PositionBlock::Size]; // pseudo-legal, as MoveGen::GeneratePseudo
+    bool inCheck[PositionBlock::Size];
+};
+
+// Number of positions analysed together, 0 when the build has no SIMD support
+#if defined(__AVX512F__)
+constexpr int Lanes = 8;
+#elif defined(__AVX2__)
+constexpr int Lanes = 4;
+#else
+constexpr int Lanes = 0;
+#endif
+
+// Uses Kogge-Stone fills across SIMD lanes, or AnalyseScalar() when Lanes is 0
+void Analyse(const PositionBlock& block, BlockResult& result);
+
+// Reference implementation, one position at a time with the magic bitboard lookups
+void AnalyseScalar(const PositionBlock& block, BlockResult& result);
+
+} // namespace BatchGen
+
+} // namespace Zugzwang
@@ -0,0 +1,933 @@
+#include "pch.h"
+#include "benchmark.h"
+#include "attacks.h"
+#include "batchgen.h"
+#include "bitboard.h"
+#include "datagen.h"
+#include "eval.h"
+#include "largepages.h"
+#include "mappedfile.h"
+#include "mate.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "stats.h"
+#include "tt.h"
+#include "uci.h"
+#include <algorithm>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <memory>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Zugzwang {
+
+namespace {
+
+// Positions from https://www.chessprogramming.org/Perft_Results, at depths that keep the whole
+// suite to a few seconds
+constexpr struct {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+} PerftSuite[] = {
+    { StartFEN, 5, 4865609 },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083 },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292 },
+    { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+    { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 },
+    { "r7/4p3/5p1q/3P4/4pQ2/4pP2/6pp/R3K1kr w Q - 1 3", 5, 11609488 },
+};
+
+// Checking mates from self-play games, the length of each confirmed by the alpha-beta search
+constexpr struct {
+    const char* fen;
+    int mate;
+} MateSuite[] = {
+    { "1R2R3/8/8/5nN1/k5PP/p2B4/1Q6/4K3 w - - 35 117", 1 },
+    { "rQ6/8/p1rp4/2BP4/P4RpN/3k4/4R3/1N1K4 w - - 1 60", 1 },
+    { "1K6/8/5q2/4k3/3n2p1/4n1n1/4q3/8 b - - 40 190", 2 },
+    { "2b1k3/n1R2r2/7n/1r3pN1/4q1Pp/7P/1N1K1b2/5B1R b - - 0 35", 2 },
+    { "nR1rk3/1q6/2R4Q/4p1P1/3pP3/p6B/PbP5/2R4K w - - 1 63", 2 },
+    { "5b2/5k2/2K5/5p2/8/4rn2/6r1/7q b - - 29 129", 3 },
+    { "5k2/8/8/2R5/pP1b1B2/P7/2N3R1/2K4Q w - - 1 80", 3 },
+    { "rBn1r3/p3kp2/1B6/6p1/PP1Q1q1P/2N2P2/8/R4K1R w - - 1 35", 3 },
+    { "2Q4n/1r6/5kB1/p3b1pP/2NP4/1pP1B1R1/8/3K4 w - - 4 67", 4 },
+    { "1B5k/3b1R2/2P5/7p/2K4P/5q2/5R2/1r4r1 b - - 9 94", 4 },
+    { "8/3k4/Q6R/Pn1p4/2p2p2/p2qN1P1/b2P4/3K4 w - - 7 58", 4 },
+    { "1R6/4k3/7r/4K3/8/p1r5/3n4/6n1 b - - 19 110", 5 },
+    { "3n1k2/3pnqp1/3P3p/3bpq2/r1P1P3/6NP/2K5/5R2 b - - 1 62", 5 },
+    { "1Q6/1b6/6k1/8/1P2R2p/2b3N1/6n1/3K4 w - - 26 98", 5 },
+    { "k7/1b2q3/8/4r2p/5R2/8/2K5/8 b - - 33 111", 6 },
+    { "1b6/3k2P1/1P4P1/1rp2b1q/2P5/P3K3/8/Q1R5 b - - 4 76", 6 },
+};
+
+// Rewrites the piece on the index-th occupied square of a record, in square order
+void setPackedPiece(PackedPosition& packed, int index, Piece piece) {
+    uint8_t& pair = packed.pieces[index / 2];
+    const int shift = 4 * (index & 1);
+    pair = uint8_t((pair & ~(0xF << shift)) | piece << shift);
+}
+
+// Records that Unpack() must refuse, as ParseFen() would refuse them as FEN, each made from a
+// valid position
+constexpr struct {
+    const char* fen;
+    void (*corrupt)(PackedPosition&);
+} CorruptRecords[] = {
+    // Castling rights without the rook
+    { "r3k3/8/8/8/8/8/8/4K2R w K - 0 1", [](PackedPosition& p) { p.stmCastling |= WHITE_OOO; } },
+    // A pawn on the last rank
+    { "4k3/P7/8/8/8/8/8/4K3 w - - 0 1", [](PackedPosition& p) { p.occupied ^= SQ_A7 | SQ_A8; } },
+    // An en passant square without the pawn that was pushed
+    { "4k3/8/8/8/8/8/8/4K3 w - - 0 1", [](PackedPosition& p) { p.epSquare = SQ_E6; } },
+    // The side not to move in check
+    { "4k3/8/8/8/8/8/8/4R1K1 b - - 0 1", [](PackedPosition& p) { p.stmCastling &= 0xF; } },
+    // Two white kings, then no black king
+    { "4k3/8/8/8/8/8/8/4K2R w - - 0 1", [](PackedPosition& p) { setPackedPiece(p, 1, W_KING); } },
+    { "4k3/8/8/8/8/8/8/4K2R w - - 0 1", [](PackedPosition& p) { setPackedPiece(p, 2, B_QUEEN); } },
+};
+
+// Counts the data TLB load misses of this thread with perf_event_open(), where the kernel and
+// the hardware allow it
+class TlbMissCounter {
+  public:
+    TlbMissCounter() {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~TlbMissCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Misses since construction, -1 if the counter is unavailable
+    int64_t Read() const {
+        uint64_t count;
+        if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+        return int64_t(count);
+    }
+
+  private:
+    int fd;
+};
+
+bool readFile(const std::string& file, std::string& content) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        std::cout << "Unable to open '" << file << "'\n";
+        return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    content.resize(size_t(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(content.data(), content.size());
+    return true;
+}
+
+// Calls f on every non-empty line, without the trailing '\r' of DOS line endings
+template <typename F>
+void forEachLine(std::string_view text, F&& f) {
+    while (!text.empty()) {
+        const size_t eol = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, eol);
+        text.remove_prefix(std::min(eol + 1, text.size()));
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            f(line);
+        }
+    }
+}
+
+// Orders moves by origin, destination, type and promotion piece
+int moveKey(Move m) {
+    return (m.FromSq() << 12) | (m.ToSq() << 6) | (m.TypeOf() >> 12) | (m.PromotionType() - KNIGHT);
+}
+
+template <typename F>
+std::vector<int> sortedKeys(const MoveList& list, F&& keep) {
+    std::vector<int> keys;
+    for (const auto& m : list) {
+        if (keep(m)) {
+            keys.push_back(moveKey(m));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+// Checks the generator families against each other on one position, returns false on a mismatch
+bool generatorsAgree(Position& pos) {
+    using namespace MoveGen;
+
+    MoveList all, captures, quiets;
+    Generate<ALL_MOVES>(pos, all);
+    Generate<CAPTURES>(pos, captures);
+    Generate<QUIETS>(pos, quiets);
+
+    auto any = [](Move) { return true; };
+    // Promotions are split by piece, capturing or not
+    auto isCapture = [&](Move m) {
+        if (m.TypeOf() == PROMOTION) {
+            return m.PromotionType() == QUEEN;
+        }
+        return pos.PieceOn(m.ToSq()) != NO_PIECE || m.TypeOf() == EN_PASSANT;
+    };
+    auto isLegal = [&](Move m) {
+        if (!pos.MakeMove(m)) {
+            return false;
+        }
+        pos.UnmakeMove(m);
+        return true;
+    };
+
+    // CAPTURES and QUIETS split ALL_MOVES
+    std::vector<int> split = sortedKeys(captures, isCapture);
+    const std::vector<int> quietKeys = sortedKeys(quiets, [&](Move m) { return !isCapture(m); });
+    if (split.size() != size_t(captures.Size()) || quietKeys.size() != size_t(quiets.Size())) {
+        return false;
+    }
+    split.insert(split.end(), quietKeys.begin(), quietKeys.end());
+    std::sort(split.begin(), split.end());
+    if (split != sortedKeys(all, any)) {
+        return false;
+    }
+
+    // EVASIONS keep every legal move when in check, QUIET_CHECKS are the checking quiet moves
+    if (pos.Checkers()) {
+        MoveList evasions;
+        Generate<EVASIONS>(pos, evasions);
+        return sortedKeys(evasions, isLegal) == sortedKeys(all, isLegal);
+    }
+
+    MoveList quietChecks;
+    Generate<QUIET_CHECKS>(pos, quietChecks);
+    return sortedKeys(quietChecks, any) == sortedKeys(quiets, [&](Move m) {
+        return m.TypeOf() == NORMAL && pos.GivesCheck(m);
+    });
+}
+
+// Unlike Position::Perft(), makes and unmakes the moves of the last ply too
+uint64_t perftMakeAll(Position& pos, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+
+    uint64_t nodes = 0;
+    for (const auto& move : list) {
+        if (pos.MakeMove(move)) {
+            nodes += perftMakeAll(pos, depth - 1);
+            pos.UnmakeMove(move);
+        }
+    }
+    return nodes;
+}
+
+void checkGenerators(Position& pos, int depth, uint64_t& nodes, uint64_t& failures) {
+    nodes++;
+    failures += !generatorsAgree(pos);
+    if (depth == 0) {
+        return;
+    }
+
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& move : list) {
+        if (pos.MakeMove(move)) {
+            checkGenerators(pos, depth - 1, nodes, failures);
+            pos.UnmakeMove(move);
+        }
+    }
+}
+
+// Calls f on pos and on every position up to 'depth' plies below it
+template <typename F>
+void forEachNode(Position& pos, int depth, F&& f) {
+    f(pos);
+    if (depth == 0) {
+        return;
+    }
+
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& move : list) {
+        if (pos.MakeMove(move)) {
+            forEachNode(pos, depth - 1, f);
+            pos.UnmakeMove(move);
+        }
+    }
+}
+
+// Compares IsPseudoLegal() and IsLegal() with the generator and MakeMove() on every 16-bit move,
+// returns the number of moves they get wrong. expected must hold 2^16 zeros and is left so.
+uint64_t legalityMismatches(Position& pos, std::vector<uint8_t>& expected) {
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& move : list) {
+        expected[move.Raw()] = 1;
+        if (pos.MakeMove(move)) {
+            pos.UnmakeMove(move);
+            expected[move.Raw()] = 3;
+        }
+    }
+
+    uint64_t mismatches = 0;
+    for (int raw = 0; raw < 1 << 16; ++raw) {
+        const Move move{ uint16_t(raw) };
+        const int got = pos.IsPseudoLegal(move) | pos.IsLegal(move) << 1;
+        if (got != expected[raw]) {
+            if (++mismatches <= 3) {
+                std::cout << "Legality mismatch: " << pos.Fen() << " move "
+                          << UCI::FormatMove(move) << " (" << raw << "): pseudo-legal/legal "
+                          << (got & 1) << "/" << (got >> 1) << " instead of "
+                          << (expected[raw] & 1) << "/" << (expected[raw] >> 1) << "\n";
+            }
+        }
+    }
+
+    for (const auto& move : list) {
+        expected[move.Raw()] = 0;
+    }
+    return mismatches;
+}
+
+// The way to validate a move without IsLegal(): generate them all and look for it
+bool generatedAndLegal(Position& pos, Move move) {
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& m : list) {
+        if (m == move) {
+            if (!pos.MakeMove(m)) {
+                return false;
+            }
+            pos.UnmakeMove(m);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+namespace Benchmark {
+
+bool Perft() {
+    using namespace std::chrono;
+
+    Position pos;
+    uint64_t total = 0;
+    bool ok = true;
+
+    const auto start = steady_clock::now();
+    for (const auto& test : PerftSuite) {
+        pos.ParseFen(test.fen);
+        const uint64_t nodes = pos.Perft(test.depth);
+        total += nodes;
+
+        if (nodes != test.nodes) {
+            std::cout << "Perft mismatch: " << test.fen << " depth " << test.depth << ": " << nodes
+                      << " instead of " << test.nodes << "\n";
+            ok = false;
+        }
+    }
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    std::cout << "Perft: " << total << " nodes in " << uint64_t(secs * 1000) << " ms, "
+              << uint64_t(total / secs) << " nodes/sec\n";
+    return ok;
+}
+
+void Sliders() {
+    std::cout << "Slider backend: " << Bitboards::SliderBackend << "\n";
+
+    const int failures = Bitboards::VerifySliders();
+    std::cout << "Equivalence test: " << (failures ? "FAILED" : "passed") << " (" << failures
+              << " mismatches)\n";
+
+    Perft();
+}
+
+bool MoveMaking() {
+    using namespace std::chrono;
+
+    auto pos = std::make_unique<Position>();
+    uint64_t total = 0;
+    bool ok = true;
+
+    const auto start = steady_clock::now();
+    for (const auto& test : PerftSuite) {
+        pos->ParseFen(test.fen);
+        const uint64_t nodes = perftMakeAll(*pos, test.depth);
+        total += nodes;
+
+        if (nodes != test.nodes) {
+            std::cout << "Perft mismatch: " << test.fen << " depth " << test.depth << ": " << nodes
+                      << " instead of " << test.nodes << "\n";
+            ok = false;
+        }
+    }
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    std::cout << "Perft (" << MakeMoveMode << ", every move made): " << total << " nodes in "
+              << uint64_t(secs * 1000) << " ms, " << uint64_t(total / secs) << " nodes/sec\n"
+              << "sizeof(Position): " << sizeof(Position) << " bytes, sizeof(BoardState): "
+              << sizeof(BoardState) << " bytes\n";
+    return ok;
+}
+
+void LargePages() {
+    if (!Bitboards::AttackTables()) {
+        std::cout << "The " << Bitboards::SliderBackend << " backend has no attack tables\n";
+        return;
+    }
+
+    // Normal pages first, so the tables are left on large pages afterwards
+    for (bool largePages : { false, true }) {
+        Bitboards::Init(largePages);
+        Bitboards::AttackTables()->Print(std::cout, "Slider attack tables");
+
+        const TlbMissCounter tlb;
+        Perft();
+
+        const int64_t misses = tlb.Read();
+        std::cout << "dTLB load misses: ";
+        if (misses < 0) {
+            std::cout << "unavailable (no perf_event_open access)\n";
+        } else {
+            std::cout << misses << "\n";
+        }
+    }
+}
+
+void Generators() {
+    using namespace std::chrono;
+
+    Position pos;
+    uint64_t nodes = 0, failures = 0;
+
+    const auto start = steady_clock::now();
+    for (const auto& test : PerftSuite) {
+        pos.ParseFen(test.fen);
+        checkGenerators(pos, std::min(test.depth - 1, 3), nodes, failures);
+    }
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    std::cout << "Generator families: " << (failures ? "FAILED" : "passed") << " on " << nodes
+              << " positions (" << failures << " mismatches) in " << uint64_t(secs * 1000)
+              << " ms\n";
+}
+
+void Attacks() {
+    using namespace std::chrono;
+
+    struct Pass {
+        uint64_t nodes = 0, lookups = 0, checksum = 0;
+        double secs = 0;
+    };
+
+    // Each pass walks the same tree, the walk alone is timed and counted first and taken off
+    auto run = [](auto&& f) {
+        Pass pass;
+        Position pos;
+        const uint64_t lookupsBefore = Stats::Total(Stats::ATTACK_LOOKUPS);
+        const auto start = steady_clock::now();
+        for (const auto& test : PerftSuite) {
+            pos.ParseFen(test.fen);
+            forEachNode(pos, std::min(test.depth - 1, 3), [&](const Position& p) {
+                pass.nodes++;
+                pass.checksum += f(p);
+            });
+        }
+        pass.secs = duration<double>(steady_clock::now() - start).count();
+        pass.lookups = Stats::Total(Stats::ATTACK_LOOKUPS) - lookupsBefore;
+        return pass;
+    };
+
+    const Pass walk = run([](const Position&) { return 0; });
+    const Pass separate = run([](const Position& pos) {
+        MoveList list;
+        MoveGen::Generate<MoveGen::ALL_MOVES>(pos, list);
+        return Eval::Evaluate(pos) + list.Size();
+    });
+    const Pass shared = run([](const Position& pos) {
+        AttackInfo ai;
+        ai.Compute(pos);
+        MoveList list;
+        MoveGen::Generate<MoveGen::ALL_MOVES>(pos, ai, list);
+        return Eval::Evaluate(pos, ai) + list.Size();
+    });
+
+    // Both generators must give the same moves in the same order
+    const Pass check = run([](const Position& pos) {
+        AttackInfo ai;
+        ai.Compute(pos);
+        MoveList plain, cached;
+        MoveGen::Generate<MoveGen::ALL_MOVES>(pos, plain);
+        MoveGen::Generate<MoveGen::ALL_MOVES>(pos, ai, cached);
+        return !std::equal(plain.begin(), plain.end(), cached.begin(), cached.end());
+    });
+
+    const bool ok = !check.checksum && separate.checksum == shared.checksum;
+    std::cout << "Attack cache: " << (ok ? "passed" : "FAILED") << " on " << walk.nodes
+              << " positions (" << check.checksum << " move list mismatches)\n";
+
+    for (const auto& [name, pass] : { std::pair{ "separate lookups", separate },
+                                      std::pair{ "shared AttackInfo", shared } }) {
+        const double secs = std::max(pass.secs - walk.secs, 1e-9);
+        std::cout << "Evaluate + Generate, " << name << ": " << uint64_t(secs * 1000) << " ms, "
+                  << uint64_t(pass.nodes / secs) << " nodes/sec";
+        if (Stats::Enabled) {
+            std::cout << ", " << std::fixed << std::setprecision(2)
+                      << double(pass.lookups - walk.lookups) / pass.nodes << std::defaultfloat
+                      << " GetAttacks calls/node";
+        }
+        std::cout << "\n";
+    }
+    if (!Stats::Enabled) {
+        std::cout << "Rebuild with -DZUGZWANG_STATS=ON to count the GetAttacks calls per node\n";
+    }
+}
+
+void MultiPV(int lines) {
+    using namespace std::chrono;
+
+    constexpr int Depth = 7;
+
+    auto pos = std::make_unique<Position>();
+    TranspositionTable tt;
+    tt.Resize(16);
+    auto worker = std::make_unique<Search::Worker>(tt);
+
+    Search::Limits limits;
+    limits.depth = Depth;
+
+    // Each search starts from an empty table and history, so both runs do the same work per line
+    double secs[2] = {};
+    uint64_t nodes[2] = {};
+    for (const auto& test : PerftSuite) {
+        pos->ParseFen(test.fen);
+
+        for (int i = 0; i < 2; ++i) {
+            tt.Clear();
+            worker->Clear();
+
+            const auto start = steady_clock::now();
+            worker->Run(*pos, limits, i == 0 ? 1 : lines, nullptr);
+            secs[i] += duration<double>(steady_clock::now() - start).count();
+            nodes[i] += worker->Nodes();
+        }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        std::cout << "MultiPV " << (i == 0 ? 1 : lines) << ", depth " << Depth << ": " << nodes[i]
+                  << " nodes in " << uint64_t(secs[i] * 1000) << " ms\n";
+    }
+    std::cout << "MultiPV " << lines << " takes " << std::fixed << std::setprecision(2)
+              << secs[1] / std::max(secs[0], 1e-9) << " times as long as a single line\n"
+              << std::defaultfloat;
+}
+
+bool Legality() {
+    using namespace std::chrono;
+
+    constexpr int Games = 8;      // random games from each suite position
+    constexpr int MaxPlies = 100; // per game
+
+    Position pos;
+    PRNG rng(1);
+    std::vector<uint8_t> expected(1 << 16);
+    std::vector<Move> candidates, line;
+    uint64_t positions = 0, mismatches = 0, checks = 0, found = 0;
+    double secs[2] = {};
+
+    for (const auto& test : PerftSuite) {
+        pos.ParseFen(test.fen);
+
+        for (int game = 0; game < Games; ++game) {
+            for (int ply = 0; ply < MaxPlies; ++ply) {
+                ++positions;
+                mismatches += legalityMismatches(pos, expected);
+
+                // Timed on the pseudo-legal moves and as many random 16-bit values, as a table
+                // of hash moves or killers would give a mix of both
+                MoveList list;
+                MoveGen::GeneratePseudo(pos, list);
+                candidates.assign(list.begin(), list.end());
+                for (int i = 0; i < list.Size(); ++i) {
+                    candidates.push_back(Move(uint16_t(rng.Rand64())));
+                }
+                checks += candidates.size();
+
+                auto start = steady_clock::now();
+                for (const auto move : candidates) {
+                    found += pos.IsLegal(move);
+                }
+                secs[0] += duration<double>(steady_clock::now() - start).count();
+
+                start = steady_clock::now();
+                for (const auto move : candidates) {
+                    found -= generatedAndLegal(pos, move);
+                }
+                secs[1] += duration<double>(steady_clock::now() - start).count();
+
+                // On to a random legal move, or a new game if there is none
+                Move next = Move::None();
+                for (int n = list.Size(); n > 0 && !next;) {
+                    const int i = rng.Below(n);
+                    if (pos.MakeMove(list[i])) {
+                        next = list[i];
+                    }
+                    list[i] = list[--n];
+                }
+                if (!next) {
+                    break;
+                }
+                line.push_back(next);
+            }
+
+            for (auto it = line.rbegin(); it != line.rend(); ++it) {
+                pos.UnmakeMove(*it);
+            }
+            line.clear();
+        }
+    }
+
+    const bool ok = mismatches == 0 && found == 0;
+    std::cout << "Legality test: " << (ok ? "passed" : "FAILED") << " on " << positions
+              << " positions, every 16-bit move (" << mismatches << " mismatches)\n";
+    for (int i = 0; i < 2; ++i) {
+        std::cout << (i == 0 ? "IsLegal(): " : "Generate and search: ") << std::fixed
+                  << std::setprecision(1) << secs[i] * 1e9 / std::max<uint64_t>(checks, 1)
+                  << " ns per move\n"
+                  << std::defaultfloat;
+    }
+    return ok;
+}
+
+bool HashTable() {
+    constexpr int Stored = 200000;
+    constexpr int Unstored = 100000;
+
+    TranspositionTable tt;
+    tt.Resize(16);
+    tt.Clear();
+    PRNG rng(1);
+
+    for (int i = 0; i < Stored; ++i) {
+        const Key key = rng.Rand64();
+        bool found;
+        tt.Probe(key, found)->Save(key, 0, BOUND_EXACT, 1, Move::None(), tt.Generation());
+    }
+
+    // Another seed, so none of these keys was stored
+    PRNG other(2);
+    int falseHits = 0;
+    for (int i = 0; i < Unstored; ++i) {
+        bool found;
+        tt.Probe(other.Rand64(), found);
+        falseHits += found;
+    }
+
+    // Four entries per cluster with 16 bits each give about one false hit in 16384 probes
+    const bool ok = falseHits <= Unstored / 1000;
+    std::cout << "Hash table test: " << (ok ? "passed" : "FAILED") << ", " << falseHits << " of "
+              << Unstored << " keys never stored were found\n";
+    return ok;
+}
+
+bool Mates() {
+    Position pos;
+    Search::Limits limits;
+    uint64_t totalNodes = 0;
+    int64_t totalMs = 0;
+    int solved = 0;
+
+    // A fresh solver per position, so no proof is carried over from the previous one
+    for (const auto& test : MateSuite) {
+        pos.ParseFen(test.fen);
+        Mate::Solver solver;
+        const Mate::Result result = solver.Run(pos, test.mate, limits, nullptr);
+
+        totalNodes += result.nodes;
+        totalMs += result.ms;
+        solved += result.mateIn == test.mate;
+
+        std::cout << "Mate " << test.mate << ": ";
+        if (result.mateIn == test.mate) {
+            std::cout << "proved";
+        } else if (result.mateIn) {
+            std::cout << "MISMATCH, mate " << result.mateIn;
+        } else {
+            std::cout << "NOT FOUND";
+        }
+        std::cout << " in " << result.ms << " ms, " << result.nodes << " nodes  " << test.fen
+                  << "\n";
+    }
+
+    const int count = int(std::size(MateSuite));
+    std::cout << "Mates: " << solved << "/" << count << " proved in " << totalMs << " ms, "
+              << totalNodes * 1000 / std::max<int64_t>(totalMs, 1) << " nodes/sec\n";
+
+    // One solver proves a mate of white, then searches a position where black attacks and has
+    // no mate, which the first proof must not be taken for
+    Mate::Solver solver;
+    pos.ParseFen("R1K4k/1b4pp/8/8/8/8/8/8 w - - 0 1");
+    const bool whiteMates = solver.Run(pos, 1, limits, nullptr).mateIn == 1;
+    pos.ParseFen("R1K4k/6pp/8/3b4/8/8/8/8 b - - 0 1");
+    const bool blackMates = solver.Run(pos, 2, limits, nullptr).mateIn != 0;
+
+    const bool reused = whiteMates && !blackMates;
+    std::cout << "Reused table: " << (reused ? "passed" : "FAILED") << "\n";
+    return solved == count && reused;
+}
+
+void FenThroughput(const std::string& file) {
+    using namespace std::chrono;
+
+    std::string content;
+    if (!readFile(file, content)) {
+        return;
+    }
+
+    Position pos;
+    uint64_t total = 0, invalid = 0, mismatches = 0;
+
+    // Parsing only
+    auto start = steady_clock::now();
+    forEachLine(content, [&](std::string_view line) {
+        total++;
+        invalid += !pos.ParseFen(line);
+    });
+    const double parseSecs = duration<double>(steady_clock::now() - start).count();
+
+    // Parsing and serializing back, checking that the round trip is stable
+    Position check;
+    start = steady_clock::now();
+    forEachLine(content, [&](std::string_view line) {
+        if (pos.ParseFen(line)) {
+            const std::string fen = pos.Fen();
+            mismatches += !check.ParseFen(fen) || check.Fen() != fen;
+        }
+    });
+    const double roundTripSecs = duration<double>(steady_clock::now() - start).count();
+
+    std::cout << "FENs: " << total << " (" << invalid << " invalid)\n"
+              << "Parse: " << uint64_t(total / std::max(parseSecs, 1e-9)) << " FENs/sec, "
+              << std::fixed << std::setprecision(1)
+              << content.size() / std::max(parseSecs, 1e-9) / (1 << 20) << " MB/s\n"
+              << std::defaultfloat
+              << "Parse + Fen() x2: " << uint64_t(total / std::max(roundTripSecs, 1e-9))
+              << " FENs/sec\n"
+              << "Round trip mismatches: " << mismatches << "\n";
+}
+
+void PackedRoundTrip(const std::string& file) {
+    using namespace std::chrono;
+
+    std::string content;
+    if (!readFile(file, content)) {
+        return;
+    }
+
+    Position pos, unpacked;
+    std::vector<PackedPosition> packed;
+    uint64_t mismatches = 0;
+
+    // Every FEN must come back identical, hash key included
+    forEachLine(content, [&](std::string_view line) {
+        if (!pos.ParseFen(line)) {
+            return;
+        }
+        packed.push_back(pos.Pack());
+        mismatches += !unpacked.Unpack(packed.back()) || unpacked.Fen() != pos.Fen() ||
+            unpacked.PosKey() != pos.PosKey();
+    });
+
+    // Each must unpack before it is corrupted and be refused after
+    int corruptFailures = 0;
+    for (const auto& record : CorruptRecords) {
+        PackedPosition p = pos.ParseFen(record.fen) ? pos.Pack() : PackedPosition{};
+        const bool clean = unpacked.Unpack(p);
+        record.corrupt(p);
+        corruptFailures += !clean || unpacked.Unpack(p);
+    }
+
+    auto start = steady_clock::now();
+    forEachLine(content, [&](std::string_view line) { pos.ParseFen(line); });
+    const double parseSecs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    start = steady_clock::now();
+    for (const auto& p : packed) {
+        unpacked.Unpack(p);
+    }
+    const double unpackSecs =
+        std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    std::cout << "Positions: " << packed.size() << ", FEN text " << content.size()
+              << " bytes, packed " << packed.size() * sizeof(PackedPosition) << " bytes\n"
+              << "Round trip mismatches: " << mismatches << "\n"
+              << "Corrupted record failures: " << corruptFailures << " of "
+              << std::size(CorruptRecords) << "\n"
+              << "ParseFen: " << uint64_t(packed.size() / parseSecs) << " positions/sec\n"
+              << "Unpack: " << uint64_t(packed.size() / unpackSecs) << " positions/sec\n";
+}
+
+void RecordDecode(const std::string& file) {
+    using namespace std::chrono;
+
+    RecordFile<DataGen::TrainingRecord> records(file);
+    if (!records.IsOpen()) {
+        std::cout << "Unable to map '" << file << "'\n";
+        return;
+    }
+
+    Position pos;
+    uint64_t invalid = 0;
+    Key seqChecksum = 0, shufChecksum = 0;
+
+    auto start = steady_clock::now();
+    records.ForEach([&](const DataGen::TrainingRecord& record) {
+        invalid += !pos.Unpack(record.position);
+        seqChecksum += pos.PosKey();
+    });
+    const double seqSecs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    // Both orders must visit every record exactly once, so the checksums have to agree
+    start = steady_clock::now();
+    records.ForEachShuffled(start.time_since_epoch().count(), [&](const auto& record) {
+        pos.Unpack(record.position);
+        shufChecksum += pos.PosKey();
+    });
+    const double shufSecs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+
+    std::cout << "Records: " << records.Size() << " (" << invalid << " invalid)\n"
+              << "Sequential decode: " << uint64_t(records.Size() / seqSecs)
+              << " positions/sec\n"
+              << "Shuffled decode: " << uint64_t(records.Size() / shufSecs) << " positions/sec\n"
+              << "Checksums " << (seqChecksum == shufChecksum ? "match" : "differ") << "\n";
+}
+
+void BatchAnalysis(const std::string& file) {
+    using namespace std::chrono;
+    using BatchGen::BlockResult;
+    using BatchGen::PositionBlock;
+
+    std::string content;
+    if (!readFile(file, content)) {
+        return;
+    }
+
+    Position pos;
+    std::vector<PackedPosition> packed;
+    std::vector<PositionBlock> blocks;
+
+    forEachLine(content, [&](std::string_view line) {
+        if (!pos.ParseFen(line)) {
+            return;
+        }
+        if (blocks.empty() || blocks.back().count == PositionBlock::Size) {
+            blocks.emplace_back();
+        }
+        packed.push_back(pos.Pack());
+        blocks.back().Set(blocks.back().count++, pos);
+    });
+
+    // Both batch implementations must agree with the move generator
+    BlockResult simd, scalar;
+    uint64_t mismatches = 0;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        BatchGen::Analyse(blocks[b], simd);
+        BatchGen::AnalyseScalar(blocks[b], scalar);
+
+        for (int i = 0; i < blocks[b].count; ++i) {
+            pos.Unpack(packed[b * PositionBlock::Size + i]);
+
+            MoveList list;
+            MoveGen::GeneratePseudo(pos, list);
+            const Color us = pos.SideToMove();
+            const bool inCheck = MoveGen::IsSquareAttacked(pos, pos.square<KING>(us), ~us);
+
+            Bitboard attacks[COLOR_NB] = {};
+            for (Square sq = SQ_A1; sq < SQUARE_NB; ++sq) {
+                for (Color c : { WHITE, BLACK }) {
+                    attacks[c] |= MoveGen::IsSquareAttacked(pos, sq, c) ? SquareBb(sq) : 0;
+                }
+            }
+
+            for (const BlockResult* r : { &simd, &scalar }) {
+                mismatches += r->moveCount[i] != list.Size() || r->inCheck[i] != inCheck ||
+                    r->attacks[WHITE][i] != attacks[WHITE] ||
+                    r->attacks[BLACK][i] != attacks[BLACK];
+            }
+        }
+    }
+
+    auto timeLoop = [&](auto&& f) {
+        const auto start = steady_clock::now();
+        f();
+        return std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+    };
+
+    uint64_t sink = 0;
+    const double unpackSecs = timeLoop([&] {
+        for (const auto& p : packed) {
+            pos.Unpack(p);
+            sink += pos.PosKey();
+        }
+    });
+    const double movegenSecs = timeLoop([&] {
+        for (const auto& p : packed) {
+            pos.Unpack(p);
+            MoveList list;
+            MoveGen::GeneratePseudo(pos, list);
+            const Color us = pos.SideToMove();
+            sink += list.Size() + MoveGen::IsSquareAttacked(pos, pos.square<KING>(us), ~us);
+        }
+    });
+    const double scalarSecs = timeLoop([&] {
+        for (const auto& block : blocks) {
+            BatchGen::AnalyseScalar(block, scalar);
+            sink += scalar.moveCount[0];
+        }
+    });
+    const double simdSecs = timeLoop([&] {
+        for (const auto& block : blocks) {
+            BatchGen::Analyse(block, simd);
+            sink += simd.moveCount[0];
+        }
+    });
+
+    const double n = double(packed.size());
+    std::cout << "Positions: " << packed.size() << ", SIMD lanes: " << BatchGen::Lanes << "\n"
+              << "Mismatches: " << mismatches << "\n"
+              << "GeneratePseudo + check: "
+              << uint64_t(n / std::max(movegenSecs - unpackSecs, 1e-9)) << " positions/sec\n"
+              << "AnalyseScalar: " << uint64_t(n / scalarSecs) << " positions/sec\n"
+              << "Analyse: " << uint64_t(n / simdSecs) << " positions/sec\n"
+              << "(checksum " << sink % 1000 << ")\n";
+}
+
+} // namespace Benchmark
+
+} // namespace Zugzwang
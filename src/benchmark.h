@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+
+namespace Zugzwang {
+
+namespace Benchmark {
+
+// Runs a fixed perft suite and reports nodes/sec, returns false on a node count mismatch
+bool Perft();
+
+// Checks the slider backend against the reference ray walk, then runs the perft suite
+void Sliders();
+
+// Runs the perft suite making and unmaking every move, including the last ply that Perft() only
+// counts, to time MakeMove() in the make/unmake or copy-make mode of this build
+bool MoveMaking();
+
+// Runs the perft suite with the slider attack tables on normal and on large pages, reporting
+// nodes/sec and data TLB misses
+void LargePages();
+
+// Walks the perft suite and checks on every position that CAPTURES and QUIETS split the full
+// generation, and that EVASIONS and QUIET_CHECKS give the moves they should
+void Generators();
+
+// Walks the perft suite and times the evaluation and move generation of every position with
+// their own attack lookups and with one shared AttackInfo, checking that the moves agree
+void Attacks();
+
+// Searches the perft suite positions to a fixed depth with one and with 'lines' principal
+// variations, and reports how much longer the MultiPV search takes
+void MultiPV(int lines);
+
+// Plays random games from the perft suite positions and checks Position::IsPseudoLegal() and
+// IsLegal() against the generator on every 16-bit move of every position, then times IsLegal()
+// against generating the moves and searching them. Returns false on a mismatch.
+bool Legality();
+
+// Stores random keys in a 16 MB transposition table and probes it with keys that were never
+// stored, returns false if more than a few of those are found
+bool HashTable();
+
+// Solves a suite of checking mates of 1 to 6 moves with the mate finder, reporting the time to
+// proof and nodes/sec, then checks that proofs kept in the table for one attacking side are not
+// used for the other. Returns false if a mate is not proved at its length or that check fails.
+bool Mates();
+
+// Parses every line of a FEN file and reports the throughput in FENs/sec
+void FenThroughput(const std::string& file);
+
+// Checks the Pack/Unpack round trip on a FEN file and compares decoding speed with ParseFen
+void PackedRoundTrip(const std::string& file);
+
+// Decodes a gensfen record file through a memory mapping, in order and shuffled
+void RecordDecode(const std::string& file);
+
+// Checks BatchGen against the move generator on a FEN file and compares their throughput
+void BatchAnalysis(const std::string& file);
+
+} // namespace Benchmark
+
+} // namespace Zugzwang
@@ -1,10 +1,14 @@
 #include "pch.h"
 #include "bitboard.h"
+#include "largepages.h"
+#include "stats.h"
 
 namespace Zugzwang {
 
 namespace {
 
+#if defined(SLIDERS_MAGIC)
+
 constexpr int RookShifts[SQUARE_NB] = { 52, 52, 52, 52, 52, 52, 52, 52, 53, 53, 53, 54, 53, 53, 54,
     53, 53, 54, 54, 54, 53, 53, 54, 53, 53, 54, 53, 53, 54, 54, 54, 53, 52, 54, 53, 53, 53, 53, 54,
     53, 52, 53, 54, 54, 53, 53, 54, 53, 53, 54, 54, 54, 53, 53, 54, 53, 52, 53, 53, 53, 53, 53, 53,
@@ -51,6 +55,9 @@ constexpr Bitboard BishopMagics[SQUARE_NB] = { 0XE51EBB94FBE45BFFULL, 0XC7B9F567
     0XD01801C04208900FULL, 0X830639EF5720980AULL, 0XC9C018202182C400ULL, 0X893B2D4094880E8CULL,
     0XFBBEFDF552EB5AE6ULL, 0XFEFFFBFB7BDFDDFBULL };
 
+#endif
+
+// Relevant occupancy of the sliders, edge squares excluded
 constexpr Bitboard RookMasks[SQUARE_NB] = { 0X101010101017eULL, 0X202020202027cULL,
     0X404040404047aULL, 0X8080808080876ULL, 0X1010101010106eULL, 0X2020202020205eULL,
     0X4040404040403eULL, 0X8080808080807eULL, 0X1010101017e00ULL, 0X2020202027c00ULL,
@@ -86,9 +93,6 @@ constexpr Bitboard BishopMasks[SQUARE_NB] = { 0X40201008040200ULL, 0X40201008040
     0XA102040000000ULL, 0X14224000000000ULL, 0X28440200000000ULL, 0X50080402000000ULL,
     0X20100804020000ULL, 0X40201008040200 };
 
-Bitboard RookAttackTable[SQUARE_NB][4096];
-Bitboard BishopAttackTable[SQUARE_NB][1024];
-
 int CreateBlockerBitboards(Bitboard movementMask, Bitboard blockers[]) {
     int numSquares = std::popcount(movementMask);
     int numPatterns = 1 << numSquares;
@@ -234,14 +238,26 @@ constexpr Bitboard PawnAttacks[2][64] = {
         0xA0000000000000ULL, 0x40000000000000ULL }
 };
 
-} // namespace
 
-namespace Bitboards {
+#if defined(SLIDERS_MAGIC)
+
+// 2.5 MB of lookups spread over the whole table, kept on huge pages to spare the TLB
+LargePageMemory AttackTableMemory;
+Bitboard (*RookAttackTable)[4096];
+Bitboard (*BishopAttackTable)[1024];
 
-void Init() {
+void initSliders(bool largePages) {
     Bitboard blockers[4096]; // 2 ^ 12
     int numPatterns;
 
+    AttackTableMemory = LargePageMemory(SQUARE_NB * (4096 + 1024) * sizeof(Bitboard), largePages);
+    if (!AttackTableMemory.Data()) {
+        std::cerr << "Failed to allocate the slider attack tables\n";
+        std::exit(EXIT_FAILURE);
+    }
+    RookAttackTable = static_cast<Bitboard(*)[4096]>(AttackTableMemory.Data());
+    BishopAttackTable = reinterpret_cast<Bitboard(*)[1024]>(RookAttackTable + SQUARE_NB);
+
     for (Square startSquare = SQ_A1; startSquare < SQUARE_NB; ++startSquare) {
         Bitboard movementMask = RookMasks[startSquare];
         numPatterns = CreateBlockerBitboards(movementMask, blockers);
@@ -266,17 +282,242 @@ void Init() {
     }
 }
 
+inline Bitboard rookAttacks(Square square, Bitboard occupancy) {
+    return RookAttackTable[square][((occupancy & RookMasks[square]) * RookMagics[square]) >>
+        RookShifts[square]];
+}
+
+inline Bitboard bishopAttacks(Square square, Bitboard occupancy) {
+    return BishopAttackTable[square][((occupancy & BishopMasks[square]) * BishopMagics[square]) >>
+        BishopShifts[square]];
+}
+
+#elif defined(SLIDERS_HYPERBOLA) || defined(SLIDERS_OBSTRUCTION)
+
+// The four lines through a square, split at the square itself: 'lower' holds the squares below
+// it, 'upper' the squares above it
+enum Line { FILE_LINE, RANK_LINE, DIAGONAL, ANTI_DIAGONAL, LINE_NB };
+
+struct LineMasks {
+    Bitboard lower, upper;
+};
+
+LineMasks Lines[LINE_NB][SQUARE_NB];
+
+Bitboard ray(Square square, int df, int dr) {
+    Bitboard b = 0;
+    for (int f = FileOf(square) + df, r = RankOf(square) + dr; f >= 0 && f < 8 && r >= 0 && r < 8;
+         f += df, r += dr) {
+        b |= MakeSquare(File(f), Rank(r));
+    }
+    return b;
+}
+
+void initLines() {
+    for (Square sq = SQ_A1; sq < SQUARE_NB; ++sq) {
+        Lines[FILE_LINE][sq] = { ray(sq, 0, -1), ray(sq, 0, 1) };
+        Lines[RANK_LINE][sq] = { ray(sq, -1, 0), ray(sq, 1, 0) };
+        Lines[DIAGONAL][sq] = { ray(sq, -1, -1), ray(sq, 1, 1) };
+        Lines[ANTI_DIAGONAL][sq] = { ray(sq, 1, -1), ray(sq, -1, 1) };
+    }
+}
+
+#if defined(SLIDERS_HYPERBOLA)
+
+// Attacks along the first rank indexed by the six inner occupancy bits and the file
+uint8_t FirstRankAttacks[64][FILE_NB];
+
+void initSliders(bool) {
+    initLines();
+
+    for (int inner = 0; inner < 64; ++inner) {
+        for (File f = FILE_A; f <= FILE_H; ++f) {
+            const Bitboard att = CreateRookBitboard(MakeSquare(f, RANK_1), Bitboard(inner) << 1);
+            FirstRankAttacks[inner][f] = uint8_t(att & Rank1BB);
+        }
+    }
+}
+
+// o ^ (o - 2r) on the line and on its mirror image, which reverses the bit order for lines
+// that cross every rank at most once
+inline Bitboard lineAttacks(Square square, Bitboard occupancy, Line line) {
+    const Bitboard mask = Lines[line][square].lower | Lines[line][square].upper;
+    Bitboard forward = occupancy & mask;
+    Bitboard reverse = __builtin_bswap64(forward);
+    forward -= SquareBb(square);
+    reverse -= __builtin_bswap64(SquareBb(square));
+    forward ^= __builtin_bswap64(reverse);
+    return forward & mask;
+}
+
+// Byte swapping doesn't mirror a rank, so ranks use a small lookup table instead
+inline Bitboard rankAttacks(Square square, Bitboard occupancy) {
+    const int shift = RankOf(square) * 8;
+    const int inner = int((occupancy >> (shift + 1)) & 63);
+    return Bitboard(FirstRankAttacks[inner][FileOf(square)]) << shift;
+}
+
+inline Bitboard rookAttacks(Square square, Bitboard occupancy) {
+    return lineAttacks(square, occupancy, FILE_LINE) | rankAttacks(square, occupancy);
+}
+
+inline Bitboard bishopAttacks(Square square, Bitboard occupancy) {
+    return lineAttacks(square, occupancy, DIAGONAL) | lineAttacks(square, occupancy, ANTI_DIAGONAL);
+}
+
+#else
+
+void initSliders(bool) { initLines(); }
+
+// The nearest lower blocker is the most significant set bit of the lower part (bit 0 stands in
+// when there is none). Subtracting it from the upper part borrows through every square up to
+// the nearest upper blocker, so the difference marks exactly the attacked stretch of the line.
+inline Bitboard lineAttacks(Square square, Bitboard occupancy, Line line) {
+    const LineMasks& m = Lines[line][square];
+    const Bitboard lower = m.lower & occupancy;
+    const Bitboard upper = m.upper & occupancy;
+    const Bitboard ms1b = 0x8000000000000000ULL >> std::countl_zero(lower | 1);
+    return (m.lower | m.upper) & (upper ^ (upper - ms1b));
+}
+
+inline Bitboard rookAttacks(Square square, Bitboard occupancy) {
+    return lineAttacks(square, occupancy, FILE_LINE) | lineAttacks(square, occupancy, RANK_LINE);
+}
+
+inline Bitboard bishopAttacks(Square square, Bitboard occupancy) {
+    return lineAttacks(square, occupancy, DIAGONAL) | lineAttacks(square, occupancy, ANTI_DIAGONAL);
+}
+
+#endif
+
+#elif defined(SLIDERS_KOGGE_STONE)
+
+void initSliders(bool) {}
+
+template <Direction D>
+constexpr Bitboard wrapMask() {
+    constexpr int file = ((D % 8) + 8) % 8;
+    return file == 1 ? ~FileABB : file == 7 ? ~FileHBB : ~0ULL;
+}
+
+template <int D>
+constexpr Bitboard shift(Bitboard b) {
+    if constexpr (D > 0) {
+        return b << D;
+    } else {
+        return b >> -D;
+    }
+}
+
+// Occluded fill from the slider over the empty squares, then one more step onto the blocker.
+// No tables and no branches, only shifts and masks.
+template <Direction D>
+inline Bitboard slide(Bitboard gen, Bitboard empty) {
+    empty &= wrapMask<D>();
+    gen |= empty & shift<D>(gen);
+    empty &= shift<D>(empty);
+    gen |= empty & shift<2 * D>(gen);
+    empty &= shift<2 * D>(empty);
+    gen |= empty & shift<4 * D>(gen);
+    return shift<D>(gen) & wrapMask<D>();
+}
+
+inline Bitboard rookAttacks(Square square, Bitboard occupancy) {
+    const Bitboard b = SquareBb(square), empty = ~occupancy;
+    return slide<NORTH>(b, empty) | slide<SOUTH>(b, empty) | slide<EAST>(b, empty) |
+        slide<WEST>(b, empty);
+}
+
+inline Bitboard bishopAttacks(Square square, Bitboard occupancy) {
+    const Bitboard b = SquareBb(square), empty = ~occupancy;
+    return slide<NORTH_EAST>(b, empty) | slide<NORTH_WEST>(b, empty) |
+        slide<SOUTH_EAST>(b, empty) | slide<SOUTH_WEST>(b, empty);
+}
+
+#endif
+
+Bitboard PseudoAttacksBB[PIECE_TYPE_NB][SQUARE_NB];
+Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
+Bitboard LineBB[SQUARE_NB][SQUARE_NB];
+
+// Needs the slider attacks, so runs after initSliders()
+void initLineTables() {
+    for (Square s1 = SQ_A1; s1 < SQUARE_NB; ++s1) {
+        PseudoAttacksBB[BISHOP][s1] = bishopAttacks(s1, 0);
+        PseudoAttacksBB[ROOK][s1] = rookAttacks(s1, 0);
+        PseudoAttacksBB[QUEEN][s1] = PseudoAttacksBB[BISHOP][s1] | PseudoAttacksBB[ROOK][s1];
+    }
+
+    for (Square s1 = SQ_A1; s1 < SQUARE_NB; ++s1) {
+        for (Square s2 = SQ_A1; s2 < SQUARE_NB; ++s2) {
+            for (PieceType pt : { BISHOP, ROOK }) {
+                if (s1 == s2 || !(PseudoAttacksBB[pt][s1] & s2)) {
+                    continue;
+                }
+                const auto attacks = pt == ROOK ? rookAttacks : bishopAttacks;
+                LineBB[s1][s2] = (PseudoAttacksBB[pt][s1] & PseudoAttacksBB[pt][s2]) | s1 | s2;
+                BetweenBB[s1][s2] = attacks(s1, SquareBb(s2)) & attacks(s2, SquareBb(s1));
+            }
+        }
+    }
+}
+
+} // namespace
+
+namespace Bitboards {
+
+void Init(bool largePages) {
+    initSliders(largePages);
+    initLineTables();
+}
+
+const LargePageMemory* AttackTables() {
+#if defined(SLIDERS_MAGIC)
+    return &AttackTableMemory;
+#else
+    return nullptr;
+#endif
+}
+
+Bitboard PseudoAttacks(PieceType pt, Square sq) { return PseudoAttacksBB[pt][sq]; }
+
+Bitboard Between(Square s1, Square s2) { return BetweenBB[s1][s2]; }
+
+Bitboard Line(Square s1, Square s2) { return LineBB[s1][s2]; }
+
+int VerifySliders() {
+    Bitboard blockers[4096];
+    int failures = 0;
+
+    // Every subset of the relevant squares, alone and with every other square occupied too
+    for (Square sq = SQ_A1; sq < SQUARE_NB; ++sq) {
+        int n = CreateBlockerBitboards(RookMasks[sq], blockers);
+        for (int i = 0; i < n; ++i) {
+            for (Bitboard occ : { blockers[i], blockers[i] | ~RookMasks[sq] }) {
+                failures += GetAttacks<ROOK>(sq, occ) != CreateRookBitboard(sq, occ);
+            }
+        }
+
+        n = CreateBlockerBitboards(BishopMasks[sq], blockers);
+        for (int i = 0; i < n; ++i) {
+            for (Bitboard occ : { blockers[i], blockers[i] | ~BishopMasks[sq] }) {
+                failures += GetAttacks<BISHOP>(sq, occ) != CreateBishopBitboard(sq, occ);
+            }
+        }
+    }
+    return failures;
+}
+
 template <PieceType P>
 Bitboard GetAttacks(Square square, Bitboard occupancy, Color color) {
+    Stats::Inc(Stats::ATTACK_LOOKUPS);
+
     if constexpr (P == ROOK) {
-        return RookAttackTable[square][((occupancy & RookMasks[square]) * RookMagics[square]) >>
-            RookShifts[square]];
+        return rookAttacks(square, occupancy);
     } else if constexpr (P == BISHOP) {
-        return BishopAttackTable[square]
-                                [((occupancy & BishopMasks[square]) * BishopMagics[square]) >>
-                                    BishopShifts[square]];
+        return bishopAttacks(square, occupancy);
     } else if constexpr (P == QUEEN) {
-        return GetAttacks<ROOK>(square, occupancy) | GetAttacks<BISHOP>(square, occupancy);
+        return rookAttacks(square, occupancy) | bishopAttacks(square, occupancy);
     } else if constexpr (P == PieceType::KNIGHT) {
         return KnightAttacks[square];
     } else if constexpr (P == PieceType::KING) {
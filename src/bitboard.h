@@ -5,9 +5,54 @@
 
 namespace Zugzwang {
 
+class LargePageMemory;
+
+constexpr Bitboard FileABB = 0x0101010101010101ULL;
+constexpr Bitboard FileBBB = FileABB << 1;
+constexpr Bitboard FileGBB = FileABB << 6;
+constexpr Bitboard FileHBB = FileABB << 7;
+
+constexpr Bitboard Rank1BB = 0xFFULL;
+constexpr Bitboard Rank2BB = Rank1BB << (8 * 1);
+constexpr Bitboard Rank3BB = Rank1BB << (8 * 2);
+constexpr Bitboard Rank6BB = Rank1BB << (8 * 5);
+constexpr Bitboard Rank7BB = Rank1BB << (8 * 6);
+constexpr Bitboard Rank8BB = Rank1BB << (8 * 7);
+
+// Slider attack backend, chosen at build time with the ZUGZWANG_SLIDERS CMake option
+#if !defined(SLIDERS_MAGIC) && !defined(SLIDERS_HYPERBOLA) && !defined(SLIDERS_OBSTRUCTION) && \
+    !defined(SLIDERS_KOGGE_STONE)
+    #define SLIDERS_MAGIC
+#endif
+
 namespace Bitboards {
 
-void Init();
+#if defined(SLIDERS_HYPERBOLA)
+constexpr const char* SliderBackend = "hyperbola quintessence";
+#elif defined(SLIDERS_OBSTRUCTION)
+constexpr const char* SliderBackend = "obstruction difference";
+#elif defined(SLIDERS_KOGGE_STONE)
+constexpr const char* SliderBackend = "Kogge-Stone";
+#else
+constexpr const char* SliderBackend = "magic bitboards";
+#endif
+
+// Also called again by the large page benchmark to rebuild the tables with and without them
+void Init(bool largePages = true);
+
+// Memory of the slider attack tables, nullptr for backends that have none
+const LargePageMemory* AttackTables();
+
+// Checks the rook and bishop attacks against a plain ray walk for every relevant occupancy
+// subset of every square, returns the number of mismatches
+int VerifySliders();
+
+// Bishop, rook or queen attacks on an empty board
+Bitboard PseudoAttacks(PieceType pt, Square sq);
+// Squares strictly between s1 and s2, empty unless they share a rank, file or diagonal
+Bitboard Between(Square s1, Square s2);
+// The whole rank, file or diagonal through s1 and s2, empty if there is none
+Bitboard Line(Square s1, Square s2);
 
 template <PieceType P>
 Bitboard GetAttacks(Square square, Bitboard occupancy = 0, Color color = WHITE);
@@ -27,6 +72,19 @@ constexpr Bitboard& operator^=(Bitboard& b, Square s) { return b ^= SquareBb(s);
 
 constexpr Bitboard operator|(Square s1, Square s2) { return SquareBb(s1) | s2; }
 
+// Moves every square of the bitboard one step in direction D, dropping what leaves the board
+template <Direction D>
+constexpr Bitboard Shift(Bitboard b) {
+    constexpr int fileStep = ((D % 8) + 8) % 8; // 1 for eastward directions, 7 for westward
+    constexpr Bitboard mask = fileStep == 1 ? ~FileABB : fileStep == 7 ? ~FileHBB : ~0ULL;
+
+    if constexpr (D > 0) {
+        return (b << D) & mask;
+    } else {
+        return (b >> -D) & mask;
+    }
+}
+
 inline Square Lsb(Bitboard b) {
     assert(b != 0);
     return static_cast<Square>(std::countr_zero(b));
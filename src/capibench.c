@@ -0,0 +1,210 @@
+/*
+ * Times the C interface against a Zugzwang process driven over a UCI pipe, on the same query:
+ * set up a position from its FEN and list its legal moves ("position fen" and "go perft 1" over
+ * the pipe). Also checks perft, make/unmake and the hash through the C interface.
+ *
+ * Usage: capibench [path to Zugzwang, default ./Zugzwang] [seconds per test, default 2]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "zugzwang.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const struct {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+} Suite[] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609 },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083 },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292 },
+    { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+    { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 },
+    { "r7/4p3/5p1q/3P4/4pQ2/4pP2/6pp/R3K1kr w Q - 1 3", 5, 11609488 },
+};
+
+#define SUITE_SIZE ((int)(sizeof(Suite) / sizeof(Suite[0])))
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A Zugzwang process reading commands from 'to' and answering on 'from' */
+typedef struct {
+    pid_t pid;
+    FILE* to;
+    FILE* from;
+} Engine;
+
+static int engineStart(Engine* engine, const char* path) {
+    int in[2], out[2];
+    if (pipe(in) < 0 || pipe(out) < 0) {
+        return -1;
+    }
+
+    engine->pid = fork();
+    if (engine->pid < 0) {
+        return -1;
+    }
+    if (engine->pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl(path, path, (char*)NULL);
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    engine->to = fdopen(in[1], "w");
+    engine->from = fdopen(out[0], "r");
+    return 0;
+}
+
+static void engineStop(Engine* engine) {
+    fputs("quit\n", engine->to);
+    fclose(engine->to);
+    fclose(engine->from);
+    waitpid(engine->pid, NULL, 0);
+}
+
+/* The number of legal moves the engine reports for fen, -1 if it is gone */
+static int engineLegalMoves(Engine* engine, const char* fen) {
+    char line[512];
+
+    fprintf(engine->to, "position fen %s\ngo perft 1\n", fen);
+    fflush(engine->to);
+    while (fgets(line, sizeof(line), engine->from)) {
+        if (strncmp(line, "Total: ", 7) == 0) {
+            return atoi(line + 7);
+        }
+    }
+    return -1;
+}
+
+/* Walks the tree checking that make/unmake restores the hash, which must match a fresh FEN */
+static int checkHashes(zz_position* pos, zz_position* scratch, int depth) {
+    zz_move moves[ZZ_MAX_MOVES];
+    char fen[ZZ_FEN_MAX];
+    const uint64_t key = zz_position_hash(pos);
+    int failures = 0;
+
+    zz_position_fen(pos, fen, sizeof(fen));
+    zz_position_set_fen(scratch, fen);
+    failures += zz_position_hash(scratch) != key;
+
+    if (depth == 0) {
+        return failures;
+    }
+    const int count = zz_legal_moves(pos, moves, ZZ_MAX_MOVES);
+    for (int i = 0; i < count; ++i) {
+        failures += zz_make_move(pos, moves[i]) != 0;
+        failures += checkHashes(pos, scratch, depth - 1);
+        zz_unmake_move(pos, moves[i]);
+        failures += zz_position_hash(pos) != key;
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "./Zugzwang";
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    int failures = 0;
+
+    printf("libzugzwang API version %d\n", zz_api_version());
+
+    zz_position* pos = zz_position_new(NULL);
+    zz_position* scratch = zz_position_new(NULL);
+    if (!pos || !scratch || zz_position_new("not a fen") != NULL) {
+        printf("zz_position_new FAILED\n");
+        return 1;
+    }
+
+    /* Perft and hashes through the interface */
+    double start = now();
+    uint64_t nodes = 0;
+    for (int i = 0; i < SUITE_SIZE; ++i) {
+        zz_position_set_fen(pos, Suite[i].fen);
+        const uint64_t n = zz_perft(pos, Suite[i].depth);
+        nodes += n;
+        if (n != Suite[i].nodes) {
+            printf("Perft mismatch: %s: %llu instead of %llu\n", Suite[i].fen,
+                   (unsigned long long)n, (unsigned long long)Suite[i].nodes);
+            ++failures;
+        }
+        failures += checkHashes(pos, scratch, 2);
+    }
+    printf("Perft and hashes: %s, %.0f perft nodes/sec\n", failures ? "FAILED" : "passed",
+           nodes / (now() - start));
+
+    /* Making and unmaking every legal move of the suite positions */
+    zz_move moves[ZZ_MAX_MOVES];
+    uint64_t made = 0;
+    start = now();
+    while (now() - start < seconds) {
+        for (int i = 0; i < SUITE_SIZE; ++i) {
+            zz_position_set_fen(pos, Suite[i].fen);
+            const int count = zz_legal_moves(pos, moves, ZZ_MAX_MOVES);
+            for (int j = 0; j < count; ++j) {
+                zz_make_move(pos, moves[j]);
+                zz_unmake_move(pos, moves[j]);
+            }
+            made += count;
+        }
+    }
+    printf("C API make + unmake: %.0f pairs/sec\n", made / (now() - start));
+
+    /* The same query both ways: FEN in, legal moves out */
+    int counts[SUITE_SIZE];
+    uint64_t queries = 0;
+    start = now();
+    while (now() - start < seconds) {
+        for (int i = 0; i < SUITE_SIZE; ++i) {
+            zz_position_set_fen(pos, Suite[i].fen);
+            counts[i] = zz_legal_moves(pos, moves, ZZ_MAX_MOVES);
+        }
+        queries += SUITE_SIZE;
+    }
+    const double apiRate = queries / (now() - start);
+    printf("C API, FEN to legal moves: %.0f queries/sec\n", apiRate);
+
+    Engine engine;
+    if (engineStart(&engine, path) < 0) {
+        printf("Unable to start '%s'\n", path);
+        return 1;
+    }
+    queries = 0;
+    start = now();
+    while (now() - start < seconds) {
+        for (int i = 0; i < SUITE_SIZE; ++i) {
+            const int count = engineLegalMoves(&engine, Suite[i].fen);
+            if (count != counts[i]) {
+                printf("UCI pipe gave %d legal moves for %s instead of %d\n", count, Suite[i].fen,
+                       counts[i]);
+                engineStop(&engine);
+                return 1;
+            }
+        }
+        queries += SUITE_SIZE;
+    }
+    const double pipeRate = queries / (now() - start);
+    engineStop(&engine);
+
+    printf("UCI pipe, FEN to legal moves: %.0f queries/sec\n", pipeRate);
+    printf("The C API answers %.1f times as fast\n", apiRate / pipeRate);
+
+    zz_position_free(pos);
+    zz_position_free(scratch);
+    return failures ? 1 : 0;
+}
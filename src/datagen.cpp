@@ -0,0 +1,256 @@
+#include "pch.h"
+#include "datagen.h"
+#include "misc.h"
+#include "movegen.h"
+#include "search.h"
+#include <atomic>
+#include <fcntl.h>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+namespace Zugzwang {
+
+namespace DataGen {
+
+namespace {
+
+constexpr int MaxGamePlies = 400;
+constexpr size_t BufferRecords = 8192;
+constexpr int HashMB = 16; // per thread
+
+// Appends whole buffers to the output file. Every writer reserves its own byte range with a
+// single atomic add and then writes it with pwrite(), so threads never wait on each other.
+class RecordSink {
+  public:
+    explicit RecordSink(const std::string& file)
+        : fd(open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {}
+    ~RecordSink() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool IsOpen() const { return fd >= 0; }
+
+    bool Write(const TrainingRecord* records, size_t count) {
+        const char* data = reinterpret_cast<const char*>(records);
+        size_t bytes = count * sizeof(TrainingRecord);
+        off_t offset = off_t(nextOffset.fetch_add(bytes, std::memory_order_relaxed));
+
+        while (bytes) {
+            const ssize_t written = pwrite(fd, data, bytes, offset);
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            bytes -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+  private:
+    int fd;
+    std::atomic<uint64_t> nextOffset{ 0 };
+};
+
+bool insufficientMaterial(const Position& pos) {
+    return pos.Pieces(PAWN, ROOK, QUEEN) == 0 && Popcount(pos.Pieces(KNIGHT, BISHOP)) <= 1;
+}
+
+// Makes a random legal move and returns it, or Move::None() if there is none
+Move makeRandomMove(Position& pos, PRNG& rng) {
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+
+    for (int n = list.Size(); n > 0;) {
+        const int i = rng.Below(n);
+        if (pos.MakeMove(list[i])) {
+            return list[i];
+        }
+        list[i] = list[--n];
+    }
+    return Move::None();
+}
+
+class Worker {
+  public:
+    Worker(const Options& opts, RecordSink& out, std::atomic<uint64_t>& done, uint64_t seed)
+        : options(opts), sink(out), generated(done), rng(seed) {
+        buffer.reserve(BufferRecords);
+        game.reserve(MaxGamePlies);
+        keys.reserve(MaxGamePlies + 1);
+        limits.depth = std::max(options.depth, 1);
+        limits.nodes = options.nodes;
+        if (!tt.Resize(HashMB)) {
+            tt.Resize(1);
+        }
+    }
+
+    void Run(uint64_t quota) {
+        while (quota) {
+            playGame();
+
+            const size_t n = std::min<uint64_t>(game.size(), quota);
+            for (size_t i = 0; i < n; ++i) {
+                buffer.push_back(game[i]);
+                if (buffer.size() == BufferRecords) {
+                    flush();
+                }
+            }
+            quota -= n;
+        }
+        flush();
+    }
+
+  private:
+    void playGame() {
+        game.clear();
+        pos.ParseFen(StartFEN);
+
+        for (int i = 0; i < options.randomPlies; ++i) {
+            if (!makeRandomMove(pos, rng)) {
+                return; // the opening ended the game, nothing to record
+            }
+        }
+
+        keys.assign(1, pos.PosKey());
+        int whiteResult = 0;
+        for (int ply = 0; ply < MaxGamePlies; ++ply) {
+            if (pos.Rule50() >= 100 || insufficientMaterial(pos) || threefold()) {
+                break;
+            }
+
+            // The search both labels the position and picks the move played from it
+            const auto& rootMoves = searcher.Run(pos, limits, 1, nullptr);
+            if (rootMoves.empty()) {
+                // Checkmate or stalemate
+                const Color us = pos.SideToMove();
+                if (MoveGen::IsSquareAttacked(pos, pos.square<KING>(us), ~us)) {
+                    whiteResult = us == WHITE ? -1 : 1;
+                }
+                break;
+            }
+
+            const Move move = rootMoves[0].pv[0];
+            // The result is filled in once the game is over
+            game.push_back({
+                .position = pos.Pack(),
+                .score = int16_t(rootMoves[0].score),
+                .move = move,
+                .result = 0,
+                .padding = {},
+            });
+            pos.MakeMove(move);
+            keys.push_back(pos.PosKey());
+        }
+
+        for (auto& record : game) {
+            const bool whiteToMove = (record.position.stmCastling >> 4) == WHITE;
+            record.result = int8_t(whiteToMove ? whiteResult : -whiteResult);
+        }
+    }
+
+    // Whether the position after the last move occurred twice before, within the reversible moves
+    bool threefold() const {
+        const int last = int(keys.size()) - 1;
+        int count = 0;
+        for (int i = last; i >= std::max(last - pos.Rule50(), 0); i -= 2) {
+            count += keys[i] == keys[last];
+        }
+        return count >= 3;
+    }
+
+    void flush() {
+        if (buffer.empty()) {
+            return;
+        }
+        if (!sink.Write(buffer.data(), buffer.size())) {
+            std::cerr << "gensfen: write error\n";
+        }
+        generated.fetch_add(buffer.size(), std::memory_order_relaxed);
+        buffer.clear();
+    }
+
+    const Options& options;
+    RecordSink& sink;
+    std::atomic<uint64_t>& generated;
+    PRNG rng;
+    Position pos;
+    Search::Limits limits;
+    TranspositionTable tt;
+    Search::Worker searcher{ tt };
+    std::vector<Key> keys; // of every position of the game after the random opening
+    std::vector<TrainingRecord> game;
+    std::vector<TrainingRecord> buffer;
+};
+
+} // namespace
+
+void Run(const Options& options) {
+    using namespace std::chrono;
+
+    RecordSink sink(options.output);
+    if (!sink.IsOpen()) {
+        std::cout << "Unable to open '" << options.output << "' for writing\n";
+        return;
+    }
+
+    const int threadCount = std::max(options.threads, 1);
+    const uint64_t seed =
+        options.seed ? options.seed : uint64_t(steady_clock::now().time_since_epoch().count());
+    std::atomic<uint64_t> generated{ 0 };
+
+    std::cout << "Generating " << options.count << " positions on " << threadCount
+              << " threads into '" << options.output << "', labelled at depth " << options.depth;
+    if (options.nodes) {
+        std::cout << " or " << options.nodes << " nodes";
+    }
+    std::cout << "\n";
+
+    const auto start = steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        const uint64_t quota =
+            options.count / threadCount + (i == 0 ? options.count % threadCount : 0);
+        const uint64_t threadSeed = seed + i * 0x9E3779B97F4A7C15ULL;
+
+        threads.emplace_back([&, quota, threadSeed] {
+            // A Worker holds a whole Position and a Search::Worker, keep them off the thread's
+            // stack
+            auto worker = std::make_unique<Worker>(options, sink, generated, threadSeed);
+            worker->Run(quota);
+        });
+    }
+
+    auto lastReport = start;
+    while (generated.load(std::memory_order_relaxed) < options.count) {
+        std::this_thread::sleep_for(milliseconds(100));
+
+        const auto now = steady_clock::now();
+        if (now - lastReport >= seconds(1)) {
+            const double secs = duration<double>(now - start).count();
+            const uint64_t n = generated.load(std::memory_order_relaxed);
+            std::cout << "info string " << n << " positions, " << uint64_t(n / secs)
+                      << " positions/sec" << std::endl;
+            lastReport = now;
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+    const uint64_t n = generated.load();
+    std::cout << "Generated " << n << " positions in " << std::fixed << std::setprecision(2)
+              << secs << " s: " << uint64_t(n / secs) << " positions/sec, "
+              << uint64_t(n / secs / threadCount) << " positions/sec/thread\n"
+              << std::defaultfloat;
+}
+
+} // namespace DataGen
+
+} // namespace Zugzwang
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "position.h"
+#include <string>
+
+namespace Zugzwang {
+
+namespace DataGen {
+
+// One labelled position, 40 bytes, written in host byte order
+struct TrainingRecord {
+    PackedPosition position;
+    int16_t score; // of a search in centipawns, from the side to move's point of view
+    Move move;     // the move played from this position
+    int8_t result; // 1 win, 0 draw, -1 loss for the side to move
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(TrainingRecord) == 40);
+
+struct Options {
+    uint64_t count = 1000000;
+    int threads = 1;
+    int randomPlies = 8; // random opening moves that are not recorded
+    int depth = 4;       // of the search that labels every position
+    uint64_t nodes = 0;  // stops the labelling search early unless zero
+    uint64_t seed = 0;
+    std::string output = "gensfen.bin";
+};
+
+// Plays self-play games on 'threads' threads and streams their positions to 'output'
+void Run(const Options& options);
+
+} // namespace DataGen
+
+} // namespace Zugzwang
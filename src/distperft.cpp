@@ -0,0 +1,380 @@
+#include "pch.h"
+#include "distperft.h"
+#include "movegen.h"
+#include "position.h"
+#include "uci.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace Zugzwang {
+
+namespace DistPerft {
+
+namespace {
+
+// A unit handed out this many times without a result ends the run
+constexpr int MaxAttempts = 3;
+
+struct Unit {
+    std::string fen; // board, side to move, castling and en passant fields
+    uint64_t nodes = 0;
+    bool done = false;
+    int attempts = 0;
+};
+
+// The distinct positions at the split ply, and for each legal root move the units below it
+struct WorkList {
+    std::vector<Unit> units;
+    std::unordered_map<std::string, size_t> index; // by FEN
+    std::vector<Move> rootMoves;
+    std::vector<std::vector<size_t>> rootUnits; // a unit reached twice is listed twice
+};
+
+// Perft does not depend on the clocks, leaving them out lets transpositions share a unit
+std::string boardFields(const Position& pos) {
+    const std::string fen = pos.Fen();
+    size_t end = 0;
+    for (int fields = 0; fields < 4 && end != std::string::npos; ++fields) {
+        end = fen.find(' ', end + (fields > 0));
+    }
+    return fen.substr(0, end);
+}
+
+void addUnits(Position& pos, int plies, std::vector<size_t>& below, WorkList& work) {
+    if (plies == 0) {
+        const auto [it, inserted] = work.index.try_emplace(boardFields(pos), work.units.size());
+        if (inserted) {
+            work.units.push_back(Unit{ it->first });
+        }
+        below.push_back(it->second);
+        return;
+    }
+
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& move : list) {
+        if (pos.MakeMove(move)) {
+            addUnits(pos, plies - 1, below, work);
+            pos.UnmakeMove(move);
+        }
+    }
+}
+
+// Checkpoint lines are "<depth> <nodes> <fen>". The FEN comes last so that a line cut short by a
+// crash cannot match a unit; lines of other depths or positions are skipped.
+int loadCheckpoint(const std::string& file, int depth, WorkList& work) {
+    std::ifstream in(file);
+    int loaded = 0;
+
+    for (std::string line; std::getline(in, line);) {
+        std::istringstream is(line);
+        int d = 0;
+        uint64_t nodes = 0;
+        std::string fen;
+        if (!(is >> d >> nodes) || d != depth || !std::getline(is >> std::ws, fen)) {
+            continue;
+        }
+
+        const auto it = work.index.find(fen);
+        if (it != work.index.end() && !work.units[it->second].done) {
+            work.units[it->second].nodes = nodes;
+            work.units[it->second].done = true;
+            ++loaded;
+        }
+    }
+    return loaded;
+}
+
+// Opens the checkpoint for appending, first ending a line that a crash may have left unfinished
+std::ofstream openCheckpoint(const std::string& file) {
+    bool endsLine = true;
+    if (std::ifstream in(file, std::ios::binary | std::ios::ate); in && in.tellg() > 0) {
+        in.seekg(-1, std::ios::end);
+        endsLine = in.get() == '\n';
+    }
+
+    std::ofstream out(file, std::ios::app);
+    if (!endsLine) {
+        out << '\n';
+    }
+    return out;
+}
+
+// A child Zugzwang that reads its commands from, and prints to, one end of a socket pair
+class WorkerProcess {
+  public:
+    ~WorkerProcess() { Stop(); }
+
+    bool Start() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+            return false;
+        }
+
+        pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            // The copies made by dup2() stay open across exec, the originals do not
+            dup2(fds[1], STDIN_FILENO);
+            dup2(fds[1], STDOUT_FILENO);
+            execl("/proc/self/exe", "Zugzwang", static_cast<char*>(nullptr));
+            _exit(127);
+        }
+
+        close(fds[1]);
+        fd = fds[0];
+        received.clear();
+        unit = -1;
+        return true;
+    }
+
+    // A worker in the middle of a unit is killed, an idle one is told to quit
+    void Stop() {
+        if (pid > 0 && unit >= 0) {
+            kill(pid, SIGKILL);
+        }
+        if (fd >= 0) {
+            Send("quit\n");
+            close(fd);
+            fd = -1;
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+            pid = -1;
+        }
+        unit = -1;
+    }
+
+    bool Send(std::string_view text) {
+        while (!text.empty()) {
+            // No SIGPIPE if the child is gone, its end of the socket reports that instead
+            const ssize_t n = send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            text.remove_prefix(size_t(n));
+        }
+        return true;
+    }
+
+    // Appends the complete lines that have arrived to 'lines', returns false once the child is
+    // gone
+    bool Receive(std::vector<std::string>& lines) {
+        char buffer[4096];
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+
+        received.append(buffer, size_t(n));
+        for (size_t eol; (eol = received.find('\n')) != std::string::npos;) {
+            lines.push_back(received.substr(0, eol));
+            received.erase(0, eol + 1);
+        }
+        return true;
+    }
+
+    int Fd() const { return fd; }
+
+    long unit = -1; // the unit being worked on, -1 when idle
+
+  private:
+    pid_t pid = -1;
+    int fd = -1;
+    std::string received; // the start of a line still coming
+};
+
+} // namespace
+
+bool Run(Position& pos, const Options& options) {
+    using namespace std::chrono;
+
+    if (options.depth < 2) {
+        std::cout << "Distributed perft needs a depth of at least 2\n";
+        return false;
+    }
+    const int splitPly = std::clamp(options.splitPly, 1, options.depth - 1);
+    const int unitDepth = options.depth - splitPly;
+
+    const auto start = steady_clock::now();
+
+    WorkList work;
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto& move : list) {
+        if (pos.MakeMove(move)) {
+            work.rootMoves.push_back(move);
+            work.rootUnits.emplace_back();
+            addUnits(pos, splitPly - 1, work.rootUnits.back(), work);
+            pos.UnmakeMove(move);
+        }
+    }
+    std::vector<Unit>& units = work.units;
+
+    int resumed = 0;
+    std::ofstream checkpoint;
+    if (!options.checkpoint.empty()) {
+        resumed = loadCheckpoint(options.checkpoint, unitDepth, work);
+        checkpoint = openCheckpoint(options.checkpoint);
+        if (!checkpoint) {
+            std::cout << "Unable to open '" << options.checkpoint << "'\n";
+            return false;
+        }
+    }
+
+    std::deque<size_t> pending;
+    for (size_t i = 0; i < units.size(); ++i) {
+        if (!units[i].done) {
+            pending.push_back(i);
+        }
+    }
+    const size_t total = pending.size();
+    size_t finished = 0;
+
+    const size_t workerCount = std::min<size_t>(std::max(options.workers, 1), pending.size());
+    std::cout << "Starting distributed perft to depth " << options.depth << ": " << units.size()
+              << " units at ply " << splitPly << ", " << resumed << " from the checkpoint, "
+              << workerCount << " workers" << std::endl;
+
+    auto assign = [&](WorkerProcess& worker) {
+        if (pending.empty()) {
+            return;
+        }
+        const size_t u = pending.front();
+        pending.pop_front();
+
+        worker.unit = long(u);
+        units[u].attempts++;
+        // A worker that died meanwhile is noticed by poll(), which requeues the unit
+        worker.Send("position fen " + units[u].fen + "\ngo perft " + std::to_string(unitDepth) +
+                    "\n");
+    };
+
+    std::vector<std::unique_ptr<WorkerProcess>> workers;
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<WorkerProcess>());
+        if (!workers.back()->Start()) {
+            std::cout << "Unable to start a worker process\n";
+            return false;
+        }
+        assign(*workers.back());
+    }
+
+    std::vector<pollfd> fds(workers.size());
+    std::vector<std::string> lines;
+    bool ok = true;
+
+    while (ok && finished < total) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            fds[i] = { workers[i]->Fd(), POLLIN, 0 };
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+
+        for (size_t i = 0; i < workers.size() && ok; ++i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            WorkerProcess& worker = *workers[i];
+
+            // The worker prints its own divide, only its total matters here
+            lines.clear();
+            const bool alive = worker.Receive(lines);
+            for (const auto& line : lines) {
+                if (worker.unit < 0 || !line.starts_with("Total: ")) {
+                    continue;
+                }
+
+                Unit& unit = units[worker.unit];
+                unit.nodes = std::strtoull(line.c_str() + 7, nullptr, 10);
+                unit.done = true;
+                if (checkpoint.is_open()) {
+                    checkpoint << unitDepth << ' ' << unit.nodes << ' ' << unit.fen << std::endl;
+                }
+
+                ++finished;
+                if (finished * 10 / total != (finished - 1) * 10 / total) {
+                    std::cout << "info string " << finished << "/" << total << " units done"
+                              << std::endl;
+                }
+
+                worker.unit = -1;
+                assign(worker);
+            }
+
+            if (alive) {
+                continue;
+            }
+
+            // Give the unit to whoever is free next, this worker included once restarted
+            if (worker.unit >= 0) {
+                const Unit& unit = units[worker.unit];
+                if (unit.attempts >= MaxAttempts) {
+                    std::cout << "Worker died " << unit.attempts << " times on '" << unit.fen
+                              << "'\n";
+                    ok = false;
+                    break;
+                }
+                pending.push_front(size_t(worker.unit));
+                worker.unit = -1;
+            }
+
+            worker.Stop();
+            if (!pending.empty()) {
+                if (!worker.Start()) {
+                    std::cout << "Unable to restart a worker process\n";
+                    ok = false;
+                    break;
+                }
+                assign(worker);
+            }
+        }
+    }
+    workers.clear();
+
+    if (!ok) {
+        std::cout << "Distributed perft stopped with " << finished << " of " << total
+                  << " units done" << (checkpoint.is_open() ? ", rerun to resume" : "") << "\n";
+        return false;
+    }
+
+    // Same output as PerftTest()
+    uint64_t nodes = 0;
+    for (size_t r = 0; r < work.rootMoves.size(); ++r) {
+        uint64_t below = 0;
+        for (const size_t u : work.rootUnits[r]) {
+            below += units[u].nodes;
+        }
+        nodes += below;
+        std::cout << UCI::FormatMove(work.rootMoves[r]) << ": " << below << "\n";
+    }
+
+    const auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    std::cout << "Total: " << nodes << " nodes in " << ms << " ms\n" << std::endl;
+    return true;
+}
+
+} // namespace DistPerft
+
+} // namespace Zugzwang
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+namespace Zugzwang {
+
+class Position;
+
+namespace DistPerft {
+
+struct Options {
+    int depth = 0;
+    int splitPly = 2; // the units are the distinct positions this many plies below the root
+    int workers = 2;
+    std::string checkpoint; // resumes from and appends to this file when given
+};
+
+// Perft of pos over separate Zugzwang processes. The tree is cut at the split ply into units of
+// FEN and remaining depth, which are handed to 'workers' child processes, one at a time each, as
+// "position fen" and "go perft" over a Unix socket. A worker that dies is restarted and its unit
+// handed out again. Every finished unit is appended to the checkpoint file, so a run stopped
+// halfway only redoes the units it had not finished. Prints the same divide and total as
+// Position::PerftTest(); returns false if the run could not be completed.
+bool Run(Position& pos, const Options& options);
+
+} // namespace DistPerft
+
+} // namespace Zugzwang
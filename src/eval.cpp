@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "eval.h"
+#include "attacks.h"
+#include "position.h"
+
+namespace Zugzwang {
+
+namespace Eval {
+
+namespace {
+
+// clang-format off
+// From White's point of view with a8 first, as the board is printed; Black reads them mirrored
+constexpr int PieceSquare[PIECE_TYPE_NB][SQUARE_NB] = {
+    {},
+    { // PAWN
+         0,   0,   0,   0,   0,   0,   0,   0,
+        50,  50,  50,  50,  50,  50,  50,  50,
+        10,  10,  20,  30,  30,  20,  10,  10,
+         5,   5,  10,  25,  25,  10,   5,   5,
+         0,   0,   0,  20,  20,   0,   0,   0,
+         5,  -5, -10,   0,   0, -10,  -5,   5,
+         5,  10,  10, -20, -20,  10,  10,   5,
+         0,   0,   0,   0,   0,   0,   0,   0 },
+    { // KNIGHT
+       -50, -40, -30, -30, -30, -30, -40, -50,
+       -40, -20,   0,   0,   0,   0, -20, -40,
+       -30,   0,  10,  15,  15,  10,   0, -30,
+       -30,   5,  15,  20,  20,  15,   5, -30,
+       -30,   0,  15,  20,  20,  15,   0, -30,
+       -30,   5,  10,  15,  15,  10,   5, -30,
+       -40, -20,   0,   5,   5,   0, -20, -40,
+       -50, -40, -30, -30, -30, -30, -40, -50 },
+    { // BISHOP
+       -20, -10, -10, -10, -10, -10, -10, -20,
+       -10,   0,   0,   0,   0,   0,   0, -10,
+       -10,   0,   5,  10,  10,   5,   0, -10,
+       -10,   5,   5,  10,  10,   5,   5, -10,
+       -10,   0,  10,  10,  10,  10,   0, -10,
+       -10,  10,  10,  10,  10,  10,  10, -10,
+       -10,   5,   0,   0,   0,   0,   5, -10,
+       -20, -10, -10, -10, -10, -10, -10, -20 },
+    { // ROOK
+         0,   0,   0,   0,   0,   0,   0,   0,
+         5,  10,  10,  10,  10,  10,  10,   5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+         0,   0,   0,   5,   5,   0,   0,   0 },
+    { // QUEEN
+       -20, -10, -10,  -5,  -5, -10, -10, -20,
+       -10,   0,   0,   0,   0,   0,   0, -10,
+       -10,   0,   5,   5,   5,   5,   0, -10,
+        -5,   0,   5,   5,   5,   5,   0,  -5,
+         0,   0,   5,   5,   5,   5,   0,  -5,
+       -10,   5,   5,   5,   5,   5,   0, -10,
+       -10,   0,   5,   0,   0,   0,   0, -10,
+       -20, -10, -10,  -5,  -5, -10, -10, -20 },
+    { // KING, middlegame
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -20, -30, -30, -40, -40, -30, -30, -20,
+       -10, -20, -20, -20, -20, -20, -20, -10,
+        20,  20,   0,   0,   0,   0,  20,  20,
+        20,  30,  10,   0,   0,  10,  30,  20 },
+};
+
+constexpr int KingEndgame[SQUARE_NB] = {
+       -50, -40, -30, -20, -20, -30, -40, -50,
+       -30, -20, -10,   0,   0, -10, -20, -30,
+       -30, -10,  20,  30,  30,  20, -10, -30,
+       -30, -10,  30,  40,  40,  30, -10, -30,
+       -30, -10,  30,  40,  40,  30, -10, -30,
+       -30, -10,  20,  30,  30,  20, -10, -30,
+       -30, -30,   0,   0,   0,   0, -30, -30,
+       -50, -30, -30, -30, -30, -30, -30, -50 };
+// clang-format on
+
+// Non-pawn material of both sides at the start, the king tables are blended by what is left
+constexpr int OpeningMaterial = 2 * (2 * PieceValue[KNIGHT] + 2 * PieceValue[BISHOP] +
+                                     2 * PieceValue[ROOK] + PieceValue[QUEEN]);
+
+// Per square a piece reaches that is neither ours nor covered by an enemy pawn
+constexpr int MobilityWeight[PIECE_TYPE_NB] = { 0, 0, 4, 5, 2, 1, 0, 0 };
+
+constexpr int KingZoneAttackPenalty = 6;  // per attack on the squares around the king
+constexpr int KingZoneDoubledPenalty = 8; // per square there the other side attacks twice
+constexpr int PawnThreatPenalty = 30;     // per piece other than a pawn attacked by a pawn
+constexpr int HangingPenalty = 15;        // per attacked piece with no defender
+
+// Mobility, king safety and threats of c, positive when good for c
+int attackTerms(const Position& pos, const AttackInfo& ai, Color c) {
+    int score = 0;
+
+    const Bitboard mobilityArea = ~pos.Pieces(c) & ~ai.byType[~c][PAWN];
+    for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt) {
+        Bitboard b = pos.Pieces(c, pt);
+        while (b) {
+            score += MobilityWeight[pt] * Popcount(ai.byPiece[PopLsb(b)] & mobilityArea);
+        }
+    }
+
+    score -= KingZoneAttackPenalty * ai.kingZoneAttacks[c];
+    score -= KingZoneDoubledPenalty * Popcount(ai.doubled[~c] & ai.kingZone[c]);
+
+    const Bitboard pieces = pos.Pieces(c) & ~pos.Pieces(c, KING);
+    score -= PawnThreatPenalty * Popcount(pieces & ~pos.Pieces(c, PAWN) & ai.byType[~c][PAWN]);
+    score -= HangingPenalty *
+             Popcount(pieces & ai.byType[~c][ALL_PIECES] & ~ai.byType[c][ALL_PIECES]);
+
+    return score;
+}
+
+} // namespace
+
+int Evaluate(const Position& pos) {
+    AttackInfo ai;
+    ai.Compute(pos);
+    return Evaluate(pos, ai);
+}
+
+int Evaluate(const Position& pos, const AttackInfo& ai) {
+    int score = 0;
+    int material = 0;
+
+    for (Color c : { WHITE, BLACK }) {
+        const int sign = c == WHITE ? 1 : -1;
+        const int flip = c == WHITE ? 56 : 0; // the tables start at a8
+
+        for (PieceType pt = PAWN; pt < KING; ++pt) {
+            Bitboard b = pos.Pieces(c, pt);
+            while (b) {
+                score += sign * (PieceValue[pt] + PieceSquare[pt][PopLsb(b) ^ flip]);
+            }
+            if (pt != PAWN) {
+                material += PieceValue[pt] * Popcount(pos.Pieces(c, pt));
+            }
+        }
+    }
+
+    const int phase = std::min(material, OpeningMaterial);
+    for (Color c : { WHITE, BLACK }) {
+        const int sq = pos.square<KING>(c) ^ (c == WHITE ? 56 : 0);
+        const int king =
+            (PieceSquare[KING][sq] * phase + KingEndgame[sq] * (OpeningMaterial - phase)) /
+            OpeningMaterial;
+        score += c == WHITE ? king : -king;
+    }
+
+    score += attackTerms(pos, ai, WHITE) - attackTerms(pos, ai, BLACK);
+
+    return pos.SideToMove() == WHITE ? score : -score;
+}
+
+} // namespace Eval
+
+} // namespace Zugzwang
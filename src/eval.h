@@ -0,0 +1,21 @@
+#pragma once
+
+#include "types.h"
+
+namespace Zugzwang {
+
+class Position;
+struct AttackInfo;
+
+namespace Eval {
+
+constexpr int PieceValue[PIECE_TYPE_NB] = { 0, 100, 320, 330, 500, 900, 0, 0 };
+
+// Material, piece-square tables, mobility, king safety and threats, from the side to move's
+// point of view. The second form takes the attacks from an AttackInfo already computed for pos.
+int Evaluate(const Position& pos);
+int Evaluate(const Position& pos, const AttackInfo& ai);
+
+} // namespace Eval
+
+} // namespace Zugzwang
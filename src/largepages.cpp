@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "largepages.h"
+#include <fstream>
+#include <sys/mman.h>
+
+namespace Zugzwang {
+
+namespace {
+
+constexpr size_t roundUp(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// mmap() only guarantees 4 KB alignment, so map one huge page more and trim both ends
+void* mapAligned(size_t bytes) {
+    const size_t padded = bytes + LargePageMemory::HugePageSize;
+    void* p = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const uintptr_t start = uintptr_t(p);
+    const uintptr_t aligned = roundUp(start, LargePageMemory::HugePageSize);
+    if (aligned > start) {
+        munmap(p, aligned - start);
+    }
+    if (const size_t tail = start + padded - (aligned + bytes)) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+} // namespace
+
+LargePageMemory::LargePageMemory(size_t bytes, bool largePages) {
+    const size_t rounded = roundUp(bytes, HugePageSize);
+
+#ifdef MAP_HUGETLB
+    if (largePages) {
+        void* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            data = p;
+            size = rounded;
+            backing = HUGETLB_PAGES;
+            return;
+        }
+    }
+#endif
+
+    data = mapAligned(rounded);
+    if (!data) {
+        return;
+    }
+    size = rounded;
+
+#ifdef MADV_HUGEPAGE
+    if (largePages && madvise(data, size, MADV_HUGEPAGE) == 0) {
+        backing = TRANSPARENT_HUGE_PAGES;
+        return;
+    }
+#endif
+#ifdef MADV_NOHUGEPAGE
+    // Keep the comparison honest when transparent huge pages are enabled system-wide
+    if (!largePages) {
+        madvise(data, size, MADV_NOHUGEPAGE);
+    }
+#endif
+}
+
+LargePageMemory::~LargePageMemory() { release(); }
+
+LargePageMemory::LargePageMemory(LargePageMemory&& other) noexcept
+    : data(other.data), size(other.size), backing(other.backing) {
+    other.data = nullptr;
+    other.size = 0;
+}
+
+LargePageMemory& LargePageMemory::operator=(LargePageMemory&& other) noexcept {
+    if (this != &other) {
+        release();
+        data = other.data;
+        size = other.size;
+        backing = other.backing;
+        other.data = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+void LargePageMemory::release() {
+    if (data) {
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+size_t LargePageMemory::HugePageBytes() const {
+    if (!data || backing == NORMAL_PAGES) {
+        return 0;
+    }
+    if (backing == HUGETLB_PAGES) {
+        return size;
+    }
+
+    // The mapping may have been merged with a neighbour, so look for the one containing data
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        unsigned long start, end;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2) {
+            inside = start <= uintptr_t(data) && uintptr_t(data) < end;
+        } else if (inside && line.rfind("AnonHugePages:", 0) == 0) {
+            return size_t(std::strtoull(line.c_str() + 14, nullptr, 10)) * 1024;
+        }
+    }
+    return 0;
+}
+
+void LargePageMemory::Print(std::ostream& os, const char* name) const {
+    constexpr const char* BackingNames[] = { "normal pages", "transparent huge pages",
+                                             "hugetlbfs pages" };
+
+    os << "info string " << name << ": " << (size >> 10) << " KB";
+    if (backing == NORMAL_PAGES) {
+        os << ", no large pages";
+    } else {
+        os << ", " << (HugePageBytes() >> 10) << " KB in 2 MB pages (" << BackingNames[backing]
+           << ")";
+    }
+    os << std::endl;
+}
+
+} // namespace Zugzwang
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace Zugzwang {
+
+// Anonymous, zero-filled memory aligned to 2 MB for the big tables. Huge pages come from the
+// reserved hugetlbfs pool (MAP_HUGETLB) when it has room, otherwise transparent huge pages are
+// requested with madvise(MADV_HUGEPAGE). Without either the memory uses normal pages.
+class LargePageMemory {
+  public:
+    enum Backing { NORMAL_PAGES, TRANSPARENT_HUGE_PAGES, HUGETLB_PAGES };
+
+    static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    LargePageMemory() = default;
+    // largePages = false gives a plain mapping, for comparisons. Data() is nullptr on failure.
+    explicit LargePageMemory(size_t bytes, bool largePages = true);
+    ~LargePageMemory();
+
+    LargePageMemory(LargePageMemory&& other) noexcept;
+    LargePageMemory& operator=(LargePageMemory&& other) noexcept;
+
+    void* Data() const { return data; }
+    size_t Size() const { return size; }
+    Backing GetBacking() const { return backing; }
+
+    // Bytes currently backed by huge pages, read from /proc/self/smaps. Transparent huge pages
+    // are best effort, so this is the way to find out whether the kernel gave any.
+    size_t HugePageBytes() const;
+
+    // One "info string" line saying whether large pages were obtained
+    void Print(std::ostream& os, const char* name) const;
+
+  private:
+    void release();
+
+    void* data = nullptr;
+    size_t size = 0;
+    Backing backing = NORMAL_PAGES;
+};
+
+} // namespace Zugzwang
@@ -1,11 +1,18 @@
 #include "pch.h"
 #include "bitboard.h"
+#include "largepages.h"
+#include "position.h"
 #include "uci.h"
 
 int main(int argc, char** argv) {
     using namespace Zugzwang;
 
     Bitboards::Init();
+    Position::Init();
+
+    if (const LargePageMemory* tables = Bitboards::AttackTables()) {
+        tables->Print(std::cout, "Slider attack tables");
+    }
     UCIEngine uci(argc, argv);
     uci.Loop();
     return 0;
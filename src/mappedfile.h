@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Zugzwang {
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+  public:
+    enum Access { SEQUENTIAL, RANDOM };
+
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOpen() const { return data != nullptr; }
+    const char* Data() const { return static_cast<const char*>(data); }
+    size_t Size() const { return size; }
+
+    // Hints the kernel about the access pattern so read-ahead can be tuned
+    void Advise(Access access) const;
+
+  private:
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+// Zero-copy view of a file made of fixed-size records of type T
+template <typename T>
+class RecordFile {
+  public:
+    explicit RecordFile(const std::string& path) : file(path) {}
+
+    bool IsOpen() const { return file.IsOpen(); }
+    size_t Size() const { return file.Size() / sizeof(T); }
+
+    const T& operator[](size_t i) const { return begin()[i]; }
+    const T* begin() const { return reinterpret_cast<const T*>(file.Data()); }
+    const T* end() const { return begin() + Size(); }
+
+    template <typename F>
+    void ForEach(F&& f) const {
+        file.Advise(MappedFile::SEQUENTIAL);
+        for (const T& record : *this) {
+            f(record);
+        }
+    }
+
+    // Visits every record once in a pseudo-random order that depends on 'seed'. The order comes
+    // from a Feistel permutation of the indices, so nothing is copied or allocated.
+    template <typename F>
+    void ForEachShuffled(uint64_t seed, F&& f) const {
+        const uint64_t n = Size();
+        if (n == 0) {
+            return;
+        }
+
+        file.Advise(MappedFile::RANDOM);
+
+        // Smallest even number of bits covering n, split into two halves
+        int halfBits = 1;
+        while ((1ULL << (2 * halfBits)) < n) {
+            ++halfBits;
+        }
+        const uint64_t mask = (1ULL << halfBits) - 1;
+
+        auto permute = [&](uint64_t x) {
+            uint64_t left = x >> halfBits, right = x & mask;
+            for (int round = 0; round < 4; ++round) {
+                uint64_t h = (right + seed + round) * 0x9E3779B97F4A7C15ULL;
+                h ^= h >> 29;
+                const uint64_t next = left ^ (h & mask);
+                left = right;
+                right = next;
+            }
+            return (left << halfBits) | right;
+        };
+
+        for (uint64_t i = 0; i < n; ++i) {
+            // The permutation covers a power of four, walk the cycle until landing inside [0, n)
+            uint64_t idx = permute(i);
+            while (idx >= n) {
+                idx = permute(idx);
+            }
+            f((*this)[idx]);
+        }
+    }
+
+  private:
+    MappedFile file;
+};
+
+} // namespace Zugzwang
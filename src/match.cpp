@@ -0,0 +1,337 @@
+#include "pch.h"
+#include "match.h"
+#include "analyse.h"
+#include "position.h"
+#include "search.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Zugzwang {
+
+namespace Match {
+
+namespace {
+
+using namespace std::chrono;
+
+struct GameResult {
+    int white;          // 1, 0 or -1
+    const char* reason; // nullptr if the game was dropped because the match ended
+};
+
+// Wins, draws and losses of engine 1
+struct Score {
+    uint64_t wins = 0;
+    uint64_t draws = 0;
+    uint64_t losses = 0;
+
+    uint64_t Games() const { return wins + draws + losses; }
+};
+
+bool insufficientMaterial(const Position& pos) {
+    return pos.Pieces(PAWN, ROOK, QUEEN) == 0 && Popcount(pos.Pieces(KNIGHT, BISHOP)) <= 1;
+}
+
+// Logistic Elo difference for an expected score, and back
+double eloOf(double score) {
+    score = std::clamp(score, 1e-6, 1 - 1e-6);
+    return 400 * std::log10(score / (1 - score));
+}
+
+double scoreOf(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+// Mean and variance of the score of one game
+void scoreStats(const Score& s, double& mean, double& variance) {
+    const double n = double(std::max<uint64_t>(s.Games(), 1));
+    const double w = s.wins / n, d = s.draws / n, l = s.losses / n;
+    mean = w + d / 2;
+    variance = w * (1 - mean) * (1 - mean) + d * (0.5 - mean) * (0.5 - mean) + l * mean * mean;
+}
+
+// Half the width of the 95% confidence interval of the Elo difference
+double eloMargin(const Score& s) {
+    double mean, variance;
+    scoreStats(s, mean, variance);
+    const double deviation = 1.96 * std::sqrt(variance / std::max<uint64_t>(s.Games(), 1));
+    return (eloOf(mean + deviation) - eloOf(mean - deviation)) / 2;
+}
+
+// Log-likelihood ratio of elo1 against elo0, with the score of a game taken as normally
+// distributed around its observed mean and variance
+double llr(const Score& s, double elo0, double elo1) {
+    double mean, variance;
+    scoreStats(s, mean, variance);
+    if (variance <= 0) {
+        return 0;
+    }
+    const double s0 = scoreOf(elo0), s1 = scoreOf(elo1);
+    return (s1 - s0) * (2 * mean - s0 - s1) * s.Games() / (2 * variance);
+}
+
+std::string describe(const EngineConfig& config) {
+    return "Hash=" + std::to_string(config.hashMB) +
+        ",EvalCache=" + std::to_string(config.evalCacheMB);
+}
+
+// One thread's two engines, each with its own table and search state, and the board they share
+class GamePlayer {
+  public:
+    explicit GamePlayer(const Options& matchOptions) : options(matchOptions) {
+        for (int i = 0; i < 2; ++i) {
+            if (!tts[i].Resize(options.engines[i].hashMB)) {
+                tts[i].Resize(1);
+            }
+            workers[i] = std::make_unique<Search::Worker>(tts[i]);
+            workers[i]->ResizeEvalCache(options.engines[i].evalCacheMB);
+        }
+    }
+
+    // Plays a game from fen with engine 1 as white or black, giving up between two moves once
+    // 'concluded' is set
+    GameResult Play(std::string_view fen, bool engine1White, const std::atomic<bool>& concluded);
+
+  private:
+    // Whether the position after the last move occurred twice before, within the reversible moves
+    bool threefold() const {
+        const int last = int(keys.size()) - 1;
+        int count = 0;
+        for (int i = last; i >= std::max(last - pos->Rule50(), 0); i -= 2) {
+            count += keys[i] == keys[last];
+        }
+        return count >= 3;
+    }
+
+    const Options& options;
+    TranspositionTable tts[2];
+    std::unique_ptr<Search::Worker> workers[2];
+    std::unique_ptr<Position> pos = std::make_unique<Position>();
+    std::vector<Key> keys; // of every position of the game
+};
+
+GameResult GamePlayer::Play(std::string_view fen, bool engine1White,
+                            const std::atomic<bool>& concluded) {
+    pos->ParseFen(fen);
+    keys.assign(1, pos->PosKey());
+    for (int i = 0; i < 2; ++i) {
+        tts[i].Clear();
+        workers[i]->Clear();
+    }
+
+    int64_t clock[COLOR_NB] = { options.time, options.time };
+    int resignPlies = 0, resignSign = 0, drawPlies = 0;
+
+    // Leaves the searches room in the move history
+    const int maxPlies = std::min(options.maxPlies, MAX_PLIES - MAX_SEARCH_PLY - 1);
+
+    for (int ply = 0; ply < maxPlies; ++ply) {
+        if (concluded.load(std::memory_order_relaxed)) {
+            return { 0, nullptr };
+        }
+
+        const Color us = pos->SideToMove();
+        Search::Worker& worker = *workers[(us == WHITE) == engine1White ? 0 : 1];
+
+        Search::Limits limits;
+        for (const Color c : { WHITE, BLACK }) {
+            limits.time[c] = clock[c];
+            limits.inc[c] = options.inc;
+        }
+
+        const auto start = steady_clock::now();
+        const auto& rootMoves = worker.Run(*pos, limits, 1, nullptr);
+        clock[us] -= duration_cast<milliseconds>(steady_clock::now() - start).count();
+
+        if (rootMoves.empty()) {
+            if (pos->Checkers()) {
+                return { us == WHITE ? -1 : 1, "mate" };
+            }
+            return { 0, "stalemate" };
+        }
+        if (clock[us] < 0) {
+            return { us == WHITE ? -1 : 1, "time forfeit" };
+        }
+        clock[us] += options.inc;
+
+        // Adjudication looks at the score of every search, from white's point of view
+        const int score = us == WHITE ? rootMoves[0].score : -rootMoves[0].score;
+
+        pos->MakeMove(rootMoves[0].pv[0]);
+        keys.push_back(pos->PosKey());
+
+        if (threefold()) {
+            return { 0, "repetition" };
+        }
+        if (pos->Rule50() >= 100) {
+            return { 0, "fifty moves" };
+        }
+        if (insufficientMaterial(*pos)) {
+            return { 0, "insufficient material" };
+        }
+
+        if (std::abs(score) >= options.resignScore) {
+            const int sign = score > 0 ? 1 : -1;
+            resignPlies = sign == resignSign ? resignPlies + 1 : 1;
+            resignSign = sign;
+        } else {
+            resignPlies = 0;
+        }
+        if (resignPlies >= options.resignPlies) {
+            return { resignSign, "adjudication" };
+        }
+
+        const bool drawish =
+            ply >= 2 * (options.drawMoveNumber - 1) && std::abs(score) <= options.drawScore;
+        drawPlies = drawish ? drawPlies + 1 : 0;
+        if (drawPlies >= options.drawPlies) {
+            return { 0, "adjudication" };
+        }
+    }
+    return { 0, "move limit" };
+}
+
+} // namespace
+
+bool ParseConfig(std::string_view text, EngineConfig& config) {
+    while (!text.empty()) {
+        const size_t comma = std::min(text.find(','), text.size());
+        const std::string_view option = text.substr(0, comma);
+        text.remove_prefix(std::min(comma + 1, text.size()));
+
+        const size_t eq = option.find('=');
+        const std::string_view name = option.substr(0, eq);
+        const int value = eq == std::string_view::npos
+            ? 0
+            : std::atoi(std::string(option.substr(eq + 1)).c_str());
+
+        if (name == "Hash") {
+            config.hashMB = std::max(value, 1);
+        } else if (name == "EvalCache") {
+            config.evalCacheMB = std::clamp(value, 0, EvalCache::MaxSizeMB);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Run(const Options& options) {
+    std::ifstream in(options.openings);
+    if (!in) {
+        std::cout << "Unable to open '" << options.openings << "'\n";
+        return;
+    }
+
+    std::vector<std::string> openings;
+    auto pos = std::make_unique<Position>();
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        const std::string_view fen = Analyse::FenFields(line);
+        if (pos->ParseFen(fen)) {
+            openings.emplace_back(fen);
+        } else {
+            std::cout << "Skipping invalid opening '" << line << "'\n";
+        }
+    }
+    if (openings.empty()) {
+        std::cout << "No openings in '" << options.openings << "'\n";
+        return;
+    }
+
+    const double lower = std::log(options.beta / (1 - options.alpha));
+    const double upper = std::log((1 - options.beta) / options.alpha);
+    const int threadCount = std::max(options.threads, 1);
+
+    std::cout << "Engine 1 (" << describe(options.engines[0]) << ") against engine 2 ("
+              << describe(options.engines[1]) << "), " << options.time / 1000.0 << "+"
+              << options.inc / 1000.0 << " s, " << openings.size() << " openings, up to "
+              << options.games << " games on " << threadCount << " threads\n";
+    std::cout << std::fixed << std::setprecision(2) << "SPRT elo0 " << options.elo0 << " elo1 "
+              << options.elo1 << " alpha " << options.alpha << " beta " << options.beta
+              << ", LLR bounds [" << lower << ", " << upper << "]\n"
+              << std::defaultfloat;
+
+    std::atomic<int> nextGame{ 0 };
+    std::atomic<bool> concluded{ false };
+    std::mutex mutex;
+    Score score;
+
+    const auto start = steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&] {
+            // Two Search::Workers and a Position, keep them off the thread's stack
+            auto player = std::make_unique<GamePlayer>(options);
+
+            for (int game; !concluded && (game = nextGame.fetch_add(1)) < options.games;) {
+                // Each opening twice in a row, engine 1 taking white first
+                const size_t opening = size_t(game / 2) % openings.size();
+                const bool engine1White = game % 2 == 0;
+                const GameResult result = player->Play(openings[opening], engine1White, concluded);
+
+                std::lock_guard lock(mutex);
+                if (!result.reason || concluded) {
+                    break;
+                }
+
+                const int forEngine1 = engine1White ? result.white : -result.white;
+                score.wins += forEngine1 > 0;
+                score.draws += forEngine1 == 0;
+                score.losses += forEngine1 < 0;
+
+                double mean, variance;
+                scoreStats(score, mean, variance);
+                const double ratio = llr(score, options.elo0, options.elo1);
+
+                std::cout << "Game " << game + 1 << " (opening " << opening + 1 << ", engine "
+                          << (engine1White ? 1 : 2) << " white): "
+                          << (result.white > 0 ? "1-0" : result.white < 0 ? "0-1" : "1/2-1/2")
+                          << " " << result.reason << " | +" << score.wins << " =" << score.draws
+                          << " -" << score.losses << std::fixed << std::setprecision(1)
+                          << " | Elo " << eloOf(mean) << " +/- " << eloMargin(score)
+                          << std::setprecision(2) << " | LLR " << ratio << "\n"
+                          << std::defaultfloat << std::flush;
+
+                if (ratio <= lower || ratio >= upper) {
+                    concluded = true;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const double secs = duration<double>(steady_clock::now() - start).count();
+    double mean, variance;
+    scoreStats(score, mean, variance);
+    const double ratio = llr(score, options.elo0, options.elo1);
+
+    std::cout << "Engine 1 against engine 2: +" << score.wins << " =" << score.draws << " -"
+              << score.losses << " in " << score.Games() << " games, " << std::fixed
+              << std::setprecision(1) << secs << " s, Elo " << eloOf(mean) << " +/- "
+              << eloMargin(score) << std::setprecision(2) << ", LLR " << ratio << ": ";
+    if (ratio >= upper) {
+        std::cout << "H1 accepted, engine 1 is at least " << options.elo1 << " Elo stronger\n";
+    } else if (ratio <= lower) {
+        std::cout << "H0 accepted, engine 1 is not " << options.elo1 << " Elo stronger\n";
+    } else {
+        std::cout << "no conclusion\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
+} // namespace Match
+
+} // namespace Zugzwang
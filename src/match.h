@@ -0,0 +1,54 @@
+#pragma once
+
+#include "tt.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Zugzwang {
+
+namespace Match {
+
+// The options one side plays with, by their UCI names
+struct EngineConfig {
+    int hashMB = 16;
+    int evalCacheMB = EvalCache::DefaultSizeMB;
+};
+
+struct Options {
+    std::string openings; // EPD or FEN file, each opening is played twice with colors swapped
+    EngineConfig engines[2];
+    int games = 1000;     // at most, the SPRT usually ends the match first
+    int threads = 1;      // games played at the same time
+    int64_t time = 10000; // ms per game and side
+    int64_t inc = 100;    // ms per move
+
+    // SPRT of the logistic Elo of engine 1 against engine 2
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+
+    // Adjudication: a win once both sides have seen a score of at least resignScore for
+    // resignPlies plies in a row, a draw once both have seen at most drawScore for drawPlies plies
+    // from move drawMoveNumber on. A game still going after maxPlies plies is a draw.
+    int resignScore = 1000;
+    int resignPlies = 6;
+    int drawScore = 10;
+    int drawPlies = 12;
+    int drawMoveNumber = 40;
+    int maxPlies = 400;
+};
+
+// Reads "Name=value,Name=value" with the option names of "setoption", e.g. "Hash=64,EvalCache=0".
+// Returns false on an unknown name.
+bool ParseConfig(std::string_view text, EngineConfig& config);
+
+// Plays engine 1 against engine 2 in process, 'threads' games at a time, each side searching on
+// its own Search::Worker and table. Prints every result with the running Elo and log-likelihood
+// ratio, and stops as soon as the SPRT accepts either hypothesis.
+void Run(const Options& options);
+
+} // namespace Match
+
+} // namespace Zugzwang
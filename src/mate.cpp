@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "mate.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "uci.h"
+#include <algorithm>
+#include <climits>
+
+namespace Zugzwang {
+
+namespace Mate {
+
+namespace {
+
+using namespace std::chrono;
+
+// Proof and disproof numbers saturate here, a node at INF is settled
+constexpr uint32_t INF = 1u << 30;
+
+// Set apart the entries of searches where black attacks
+constexpr Key BlackAttackerKey = 0x9E3779B97F4A7C15ULL;
+
+int64_t elapsedMs(steady_clock::time_point start) {
+    return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+// The legal moves of a side in check, all of which are evasions
+int evasionCount(Position& pos) {
+    MoveList list;
+    MoveGen::Generate<MoveGen::EVASIONS>(pos, list);
+
+    int count = 0;
+    for (const auto move : list) {
+        if (pos.MakeMove(move)) {
+            pos.UnmakeMove(move);
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Whether the move just made checks the side now to move
+bool givesCheck(const Position& pos) {
+    const Color them = pos.SideToMove();
+    return MoveGen::IsSquareAttacked(pos, pos.square<KING>(them), ~them);
+}
+
+} // namespace
+
+void Solver::Resize(size_t mb) {
+    const size_t count = std::bit_floor(std::max<size_t>(mb, 1) * 1024 * 1024 / sizeof(Entry));
+
+    // An empty entry holds no numbers for any depth
+    table.assign(count, Entry{ 0, 1, 1, -1 });
+    table.shrink_to_fit();
+    mask = count - 1;
+}
+
+Result Solver::Run(Position& pos, int moves, const Search::Limits& limits, std::ostream* os) {
+    if (table.empty()) {
+        Resize(DefaultHashMB);
+    }
+
+    startTime = steady_clock::now();
+    nodes = 0;
+    nextCheck = 0;
+    maxNodes = limits.nodes;
+    maxTime = limits.movetime;
+    stopped = false;
+    attackerKey = pos.SideToMove() == WHITE ? 0 : BlackAttackerKey;
+
+    Result result;
+    moves = std::clamp(moves, 1, MaxMoves);
+
+    // Deepening one move at a time makes the first mate found the shortest
+    int depth = 1;
+    for (int n = 1; n <= moves; ++n) {
+        depth = 2 * n - 1;
+
+        uint32_t pn, dn;
+        mid(pos, true, depth, INF, INF, pn, dn);
+        if (stopped) {
+            break;
+        }
+        if (pn == 0) {
+            result.mateIn = n;
+            result.pv = provenLine(pos, depth);
+            break;
+        }
+
+        if (os) {
+            const int64_t ms = elapsedMs(startTime);
+            *os << "info depth " << depth << " nodes " << nodes << " nps "
+                << nodes * 1000 / std::max<int64_t>(ms, 1) << " time " << ms << std::endl;
+        }
+    }
+
+    result.nodes = nodes;
+    result.ms = elapsedMs(startTime);
+
+    if (os && result.mateIn) {
+        *os << "info depth " << depth << " score mate " << result.mateIn << " nodes " << nodes
+            << " nps " << nodes * 1000 / std::max<int64_t>(result.ms, 1) << " time " << result.ms
+            << " pv";
+        for (const auto move : result.pv) {
+            *os << ' ' << UCI::FormatMove(move);
+        }
+        *os << std::endl;
+    }
+    return result;
+}
+
+// Searches the node until its proof number reaches thpn or its disproof number thdn. At attacker
+// nodes the proof number is the smallest of the children and the disproof number their sum, at
+// defender nodes the other way round; the child that decides the smallest one is searched next,
+// with thresholds that send control back here as soon as another child would take its place.
+void Solver::mid(Position& pos, bool attacker, int depth, uint32_t thpn, uint32_t thdn,
+                 uint32_t& pn, uint32_t& dn) {
+    Child children[MAX_MOVES];
+    const int count = expand(pos, attacker, depth, children);
+
+    while (true) {
+        // With no children this gives a refuted attacker node and a mated defender
+        uint32_t smallest = INF, second = INF;
+        uint64_t sum = 0;
+        int best = 0;
+        for (int i = 0; i < count; ++i) {
+            const uint32_t n = attacker ? children[i].pn : children[i].dn;
+            sum += attacker ? children[i].dn : children[i].pn;
+            if (n < smallest) {
+                second = smallest;
+                smallest = n;
+                best = i;
+            } else if (n < second) {
+                second = n;
+            }
+        }
+        pn = attacker ? smallest : uint32_t(std::min<uint64_t>(sum, INF));
+        dn = attacker ? uint32_t(std::min<uint64_t>(sum, INF)) : smallest;
+
+        if (pn >= thpn || dn >= thdn || checkLimits()) {
+            break;
+        }
+
+        Child& child = children[best];
+        const uint32_t childThpn = attacker ? std::min(thpn, second + 1) : thpn - pn + child.pn;
+        const uint32_t childThdn = attacker ? thdn - dn + child.dn : std::min(thdn, second + 1);
+
+        pos.MakeMove(child.move);
+        mid(pos, !attacker, depth - 1, childThpn, childThdn, child.pn, child.dn);
+        pos.UnmakeMove(child.move);
+    }
+
+    if (!stopped) {
+        store(tableKey(pos), depth, pn, dn);
+    }
+}
+
+// Lists the checking moves of the attacker or the evasions of the defender with their starting
+// numbers: from the table when it has them, otherwise the number of replies for a checked defender
+// (0 is mate), which makes positions with fewer escapes look closer to a proof
+int Solver::expand(Position& pos, bool attacker, int depth, Child* children) {
+    MoveList list;
+    if (pos.Checkers()) {
+        MoveGen::Generate<MoveGen::EVASIONS>(pos, list);
+    } else {
+        MoveGen::GeneratePseudo(pos, list);
+    }
+
+    int count = 0;
+    for (const auto move : list) {
+        if (!pos.MakeMove(move)) {
+            continue;
+        }
+        ++nodes;
+
+        if (!attacker || givesCheck(pos)) {
+            Child& child = children[count++];
+            child.move = move;
+
+            if (!probe(tableKey(pos), depth - 1, child.pn, child.dn)) {
+                if (attacker) {
+                    const int replies = evasionCount(pos);
+                    child.pn = replies ? (depth > 1 ? uint32_t(replies) : INF) : 0;
+                    child.dn = replies ? (depth > 1 ? 1 : 0) : INF;
+                } else {
+                    child.pn = child.dn = 1;
+                }
+            }
+        }
+        pos.UnmakeMove(move);
+    }
+    return count;
+}
+
+Key Solver::tableKey(const Position& pos) const { return pos.PosKey() ^ attackerKey; }
+
+// A mate within some depth stands for any larger depth and a refutation for any smaller one,
+// unsettled numbers only for the depth they were computed at
+bool Solver::probe(Key key, int depth, uint32_t& pn, uint32_t& dn) const {
+    const Entry& e = table[key & mask];
+    if (e.key != key) {
+        return false;
+    }
+
+    if (e.pn == 0 && e.depth <= depth) {
+        pn = 0;
+        dn = INF;
+    } else if (e.dn == 0 && e.depth >= depth) {
+        pn = INF;
+        dn = 0;
+    } else if (e.depth == depth) {
+        pn = e.pn;
+        dn = e.dn;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Solver::store(Key key, int depth, uint32_t pn, uint32_t dn) {
+    table[key & mask] = { key, pn, dn, depth };
+}
+
+// Follows the proof from the table: the attacker takes the move proved with the fewest plies
+// left, the defender the reply that needed the most. Stops early if an entry was overwritten.
+std::vector<Move> Solver::provenLine(Position& pos, int depth) const {
+    std::vector<Move> line;
+
+    for (bool attacker = true; depth > 0; attacker = !attacker, --depth) {
+        MoveList list;
+        if (pos.Checkers()) {
+            MoveGen::Generate<MoveGen::EVASIONS>(pos, list);
+        } else {
+            MoveGen::GeneratePseudo(pos, list);
+        }
+
+        Move best = Move::None();
+        int bestPlies = attacker ? INT_MAX : -1;
+        for (const auto move : list) {
+            if (!pos.MakeMove(move)) {
+                continue;
+            }
+
+            int plies = -1; // needed to mate after the move, -1 if unknown
+            if (attacker && givesCheck(pos) && !evasionCount(pos)) {
+                plies = 0;
+            } else if (!attacker || givesCheck(pos)) {
+                const Key key = tableKey(pos);
+                const Entry& e = table[key & mask];
+                if (e.key == key && e.pn == 0 && e.depth <= depth - 1) {
+                    plies = e.depth;
+                }
+            }
+            pos.UnmakeMove(move);
+
+            if (plies >= 0 && (attacker ? plies < bestPlies : plies > bestPlies)) {
+                best = move;
+                bestPlies = plies;
+            }
+        }
+
+        if (!best) {
+            break;
+        }
+        line.push_back(best);
+        pos.MakeMove(best);
+        if (bestPlies == 0) {
+            break;
+        }
+    }
+
+    for (auto it = line.rbegin(); it != line.rend(); ++it) {
+        pos.UnmakeMove(*it);
+    }
+    return line;
+}
+
+bool Solver::checkLimits() {
+    if (stopped || nodes < nextCheck) {
+        return stopped;
+    }
+    nextCheck = nodes + 4096;
+
+    stopped = stopRequested.load(std::memory_order_relaxed) || (maxNodes && nodes >= maxNodes) ||
+              (maxTime && elapsedMs(startTime) >= maxTime);
+    return stopped;
+}
+
+} // namespace Mate
+
+} // namespace Zugzwang
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+namespace Zugzwang {
+
+class Position;
+
+namespace Search {
+struct Limits;
+}
+
+namespace Mate {
+
+struct Result {
+    int mateIn = 0;        // moves of the side to move, 0 if no mate was proved
+    std::vector<Move> pv;  // a mating line, starting with the move to play
+    uint64_t nodes = 0;
+    int64_t ms = 0;
+};
+
+// Depth-first proof-number search (df-pn) for mates in which every move of the attacker gives
+// check, the defender trying all of its evasions. The proof and disproof numbers of the positions
+// searched are kept with their remaining depth in the solver's own table, which lasts from one
+// search to the next: a mate found within some depth holds for any larger one, a refutation for
+// any smaller one. Entries are keyed on the attacking side as well, as a position proved with
+// one side attacking says nothing of the other side's mates.
+class Solver {
+  public:
+    static constexpr int DefaultHashMB = 16;
+    static constexpr int MaxMoves = 63; // the longest mate it looks for
+
+    // Finds the shortest mate in at most 'moves' moves, trying 1, 2, ... moves in turn, until
+    // limits.nodes or limits.movetime runs out or Stop() is called. Prints "info" lines to os
+    // unless it is nullptr. pos is left as it was.
+    Result Run(Position& pos, int moves, const Search::Limits& limits, std::ostream* os);
+
+    // Drops a Stop() that came after the last search. Call it before Run() is started on another
+    // thread, so that an early Stop() is not lost.
+    void Prepare() { stopRequested.store(false, std::memory_order_relaxed); }
+    void Stop() { stopRequested.store(true, std::memory_order_relaxed); }
+
+    // Allocates the table on first use, dropping the contents
+    void Resize(size_t mb);
+
+  private:
+    struct Entry {
+        Key key;
+        uint32_t pn; // 0 once a mate is proved
+        uint32_t dn; // 0 once it is refuted
+        int depth;   // plies left when the numbers were computed
+    };
+
+    struct Child {
+        Move move;
+        uint32_t pn;
+        uint32_t dn;
+    };
+
+    void mid(Position& pos, bool attacker, int depth, uint32_t thpn, uint32_t thdn, uint32_t& pn,
+             uint32_t& dn);
+    int expand(Position& pos, bool attacker, int depth, Child* children);
+    // The position key with the attacking side folded in
+    Key tableKey(const Position& pos) const;
+    bool probe(Key key, int depth, uint32_t& pn, uint32_t& dn) const;
+    void store(Key key, int depth, uint32_t pn, uint32_t dn);
+    std::vector<Move> provenLine(Position& pos, int depth) const;
+    bool checkLimits();
+
+    std::vector<Entry> table;
+    size_t mask = 0;
+    Key attackerKey = 0; // of the side to move at the root of the current search
+
+    std::chrono::steady_clock::time_point startTime;
+    uint64_t nodes = 0;
+    uint64_t nextCheck = 0; // node count at which the limits are looked at again
+    uint64_t maxNodes = 0;
+    int64_t maxTime = 0; // ms
+    bool stopped = false;
+    std::atomic<bool> stopRequested{ false };
+};
+
+} // namespace Mate
+
+} // namespace Zugzwang
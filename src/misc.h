@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Zugzwang {
+
+// xorshift64* generator, small and fast enough for per-thread use in hot loops
+class PRNG {
+  public:
+    explicit PRNG(uint64_t seed) : s(seed ? seed : 1804289383ULL) {}
+
+    uint64_t Rand64() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 2685821657736338717ULL;
+    }
+
+    // Uniform enough for small n
+    uint32_t Below(uint32_t n) { return uint32_t((Rand64() >> 32) * n >> 32); }
+
+  private:
+    uint64_t s;
+};
+
+} // namespace Zugzwang
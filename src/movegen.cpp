@@ -1,7 +1,9 @@
 #include "pch.h"
+#include "attacks.h"
 #include "bitboard.h"
 #include "movegen.h"
 #include "position.h"
+#include "stats.h"
 
 namespace Zugzwang {
 namespace {
@@ -12,90 +14,169 @@ inline void SplatMoves(MoveList& list, Square from, Bitboard toBb) {
     }
 }
 
-template <Color Us, PieceType Pt>
-void GenerateMoves(const Position& pos, MoveList& list, Bitboard target) {
+// ai, when given, supplies the attacks of each piece instead of a GetAttacks() lookup
+template <Color Us, PieceType Pt, bool Checks>
+void GenerateMoves(const Position& pos, MoveList& list, Bitboard target, const AttackInfo* ai) {
     static_assert(Pt != KING && Pt != PAWN, "Unsupported piece type in GenerateMoves()");
 
     Bitboard bb = pos.Pieces(Us, Pt);
 
     while (bb) {
         Square from = PopLsb(bb);
-        Bitboard b = Bitboards::GetAttacks<Pt>(from, pos.Pieces()) & target;
+        Bitboard b = ai ? ai->byPiece[from] : Bitboards::GetAttacks<Pt>(from, pos.Pieces());
+        b &= target;
+
+        // A piece that blocks one of our sliders also checks by leaving the blocked line
+        if constexpr (Checks) {
+            const Bitboard discovered = pos.BlockersForKing(~Us) & from
+                ? ~Bitboards::Line(from, pos.square<KING>(~Us))
+                : 0;
+            b &= pos.CheckSquares(Pt) | discovered;
+        }
 
         SplatMoves(list, from, b);
     }
 }
 
-template <Color Us>
-void GeneratePawnMoves(const Position& pos, MoveList& list) {
-    constexpr Piece pawn = MakePiece(Us, PAWN);
-    constexpr Rank startRank = RelativeRank(Us, RANK_2);
-    constexpr Rank promoRank = RelativeRank(Us, RANK_7);
-
-    auto addPromotions = [&](Square startSq, Square toSq) {
-        list.Insert(Move::Make<PROMOTION>(startSq, toSq, QUEEN));
-        list.Insert(Move::Make<PROMOTION>(startSq, toSq, ROOK));
-        list.Insert(Move::Make<PROMOTION>(startSq, toSq, BISHOP));
-        list.Insert(Move::Make<PROMOTION>(startSq, toSq, KNIGHT));
-    };
+template <Direction D>
+inline void SplatPawnMoves(MoveList& list, Bitboard toBb) {
+    while (toBb) {
+        const Square to = PopLsb(toBb);
+        list.Insert(Move(to - D, to));
+    }
+}
 
-    Bitboard bb = pos.Pieces(Us, PAWN);
+// Queen promotions go with the captures, underpromotions with the quiet moves
+template <MoveGen::GenType Type, Direction D>
+inline void SplatPromotions(MoveList& list, Bitboard toBb) {
+    using namespace MoveGen;
 
-    while (bb) {
-        Square from = PopLsb(bb);
-        const Rank rank = RankOf(from);
-        const Square oneForward = from + PawnPush(Us);
-
-        assert(IsOk(oneForward));
-
-        // pushes
-        if (pos.PieceOn(oneForward) == NO_PIECE) {
-            if (rank == promoRank) {
-                addPromotions(from, oneForward);
-            } else {
-                const Square twoForward = from + 2 * PawnPush(Us);
-                assert(IsOk(twoForward));
-
-                list.Insert(Move(from, oneForward));
-                if (rank == startRank && pos.PieceOn(twoForward) == NO_PIECE) {
-                    list.Insert(Move(from, twoForward));
-                }
-            }
+    constexpr bool queens = Type == CAPTURES || Type == EVASIONS || Type == ALL_MOVES;
+    constexpr bool underpromotions = Type == QUIETS || Type == EVASIONS || Type == ALL_MOVES;
+
+    while (toBb) {
+        const Square to = PopLsb(toBb);
+        const Square from = to - D;
+        if constexpr (queens) {
+            list.Insert(Move::Make<PROMOTION>(from, to, QUEEN));
+        }
+        if constexpr (underpromotions) {
+            list.Insert(Move::Make<PROMOTION>(from, to, ROOK));
+            list.Insert(Move::Make<PROMOTION>(from, to, BISHOP));
+            list.Insert(Move::Make<PROMOTION>(from, to, KNIGHT));
         }
+    }
+}
 
-        // captures
-        const Bitboard pawnAtt = Bitboards::GetAttacks<PAWN>(from, 0, Us);
-        Bitboard captures = pawnAtt & pos.Pieces(~Us);
+// Generates the moves of all pawns at once: every kind of pawn move is a shift of the whole
+// pawn set, and the origin of each target square is recovered from the shift direction. For
+// EVASIONS, target holds the checker and the squares between it and the king.
+template <Color Us, MoveGen::GenType Type>
+void GeneratePawnMoves(const Position& pos, MoveList& list, Bitboard target) {
+    using namespace MoveGen;
+
+    constexpr Color Them = ~Us;
+    constexpr Direction Up = PawnPush(Us);
+    constexpr Direction UpLeft = Us == WHITE ? NORTH_WEST : SOUTH_EAST;
+    constexpr Direction UpRight = Us == WHITE ? NORTH_EAST : SOUTH_WEST;
+    constexpr Bitboard Rank3 = Us == WHITE ? Rank3BB : Rank6BB;
+    constexpr Bitboard Rank7 = Us == WHITE ? Rank7BB : Rank2BB;
+
+    const Bitboard empty = ~pos.Pieces();
+    const Bitboard enemies = Type == EVASIONS ? pos.Checkers() : pos.Pieces(Them);
+    const Bitboard pawnsOn7 = pos.Pieces(Us, PAWN) & Rank7;
+    const Bitboard pawnsNotOn7 = pos.Pieces(Us, PAWN) & ~Rank7;
+
+    // pushes
+    if constexpr (Type != CAPTURES) {
+        Bitboard push = Shift<Up>(pawnsNotOn7) & empty;
+        Bitboard doublePush = Shift<Up>(push & Rank3) & empty;
+
+        if constexpr (Type == EVASIONS) {
+            push &= target;
+            doublePush &= target;
+        }
 
-        while (captures) {
-            Square to = PopLsb(captures);
-            if (rank == promoRank) {
-                addPromotions(from, to);
-            } else {
-                list.Insert(Move(from, to));
-            }
+        if constexpr (Type == QUIET_CHECKS) {
+            // Direct checks, and pushes that uncover a check, which a pawn on the king's file
+            // can't do
+            const Square ksq = pos.square<KING>(Them);
+            const Bitboard dcPawns =
+                pawnsNotOn7 & pos.BlockersForKing(Them) & ~(FileABB << FileOf(ksq));
+            const Bitboard dcPush = Shift<Up>(dcPawns) & empty;
+            const Bitboard dcDoublePush = Shift<Up>(dcPush & Rank3) & empty;
+
+            push = (push & pos.CheckSquares(PAWN)) | dcPush;
+            doublePush = (doublePush & pos.CheckSquares(PAWN)) | dcDoublePush;
         }
 
-        // en passant
-        if (pos.EpSuare() != SQ_NONE && (pawnAtt & (1ULL << pos.EpSuare()))) {
-            list.Insert(Move::Make<EN_PASSANT>(from, pos.EpSuare()));
+        SplatPawnMoves<Up>(list, push);
+        SplatPawnMoves<Up + Up>(list, doublePush);
+    }
+
+    // captures
+    if constexpr (Type == CAPTURES || Type == EVASIONS || Type == ALL_MOVES) {
+        SplatPawnMoves<UpLeft>(list, Shift<UpLeft>(pawnsNotOn7) & enemies);
+        SplatPawnMoves<UpRight>(list, Shift<UpRight>(pawnsNotOn7) & enemies);
+    }
+
+    // promotions
+    if (Type != QUIET_CHECKS && pawnsOn7) {
+        const Bitboard pushTarget = Type == EVASIONS ? empty & target : empty;
+        SplatPromotions<Type, Up>(list, Shift<Up>(pawnsOn7) & pushTarget);
+        SplatPromotions<Type, UpLeft>(list, Shift<UpLeft>(pawnsOn7) & enemies);
+        SplatPromotions<Type, UpRight>(list, Shift<UpRight>(pawnsOn7) & enemies);
+    }
+
+    // en passant, which only evades a check given by the pawn that just moved
+    if constexpr (Type == CAPTURES || Type == EVASIONS || Type == ALL_MOVES) {
+        const Square ep = pos.EpSuare();
+        if (ep != SQ_NONE && (Type != EVASIONS || (target & (ep - Up)))) {
+            Bitboard b = pawnsNotOn7 & Bitboards::GetAttacks<PAWN>(ep, 0, Them);
+            while (b) {
+                list.Insert(Move::Make<EN_PASSANT>(PopLsb(b), ep));
+            }
         }
     }
 }
 
-template <Color Us>
-void GenerateKingMoves(const Position& pos, MoveList& list) {
+template <Color Us, MoveGen::GenType Type>
+void GenerateKingMoves(const Position& pos, MoveList& list, const AttackInfo* ai) {
+    using namespace MoveGen;
+
     Square startSq = pos.square<KING>(Us);
 
-    Bitboard attacks = Bitboards::GetAttacks<KING>(startSq) & ~pos.Pieces(Us);
+    Bitboard target;
+    if constexpr (Type == CAPTURES) {
+        target = pos.Pieces(~Us);
+    } else if constexpr (Type == QUIETS) {
+        target = ~pos.Pieces();
+    } else if constexpr (Type == QUIET_CHECKS) {
+        // The king can only give a discovered check, by leaving the line it blocks
+        target = pos.BlockersForKing(~Us) & startSq
+            ? ~pos.Pieces() & ~Bitboards::Line(startSq, pos.square<KING>(~Us))
+            : 0;
+    } else {
+        target = ~pos.Pieces(Us);
+    }
+
+    Bitboard attacks = (ai ? ai->byPiece[startSq] : Bitboards::GetAttacks<KING>(startSq)) & target;
     SplatMoves(list, startSq, attacks);
 
+    if constexpr (Type != QUIETS && Type != ALL_MOVES) {
+        return;
+    }
+
+    auto attacked = [&](Square sq) {
+        return ai ? bool(ai->byType[~Us][ALL_PIECES] & sq)
+                  : MoveGen::IsSquareAttacked(pos, sq, ~Us);
+    };
+
     // castling
     if constexpr (Us == WHITE) {
         if (pos.CanCastle(WHITE_OO)) {
             if (pos.PieceOn(SQ_F1) == NO_PIECE && pos.PieceOn(SQ_G1) == NO_PIECE) {
-                if (!MoveGen::IsSquareAttacked(pos, SQ_E1, BLACK) &&
-                    !MoveGen::IsSquareAttacked(pos, SQ_F1, BLACK)) {
+                if (!attacked(SQ_E1) && !attacked(SQ_F1)) {
                     list.Insert(Move::Make<CASTLING>(SQ_E1, SQ_G1));
                 }
             }
@@ -104,8 +185,7 @@ void GenerateKingMoves(const Position& pos, MoveList& list) {
         if (pos.CanCastle(WHITE_OOO)) {
             if (pos.PieceOn(SQ_D1) == NO_PIECE && pos.PieceOn(SQ_C1) == NO_PIECE &&
                 pos.PieceOn(SQ_B1) == NO_PIECE) {
-                if (!MoveGen::IsSquareAttacked(pos, SQ_E1, BLACK) &&
-                    !MoveGen::IsSquareAttacked(pos, SQ_D1, BLACK)) {
+                if (!attacked(SQ_E1) && !attacked(SQ_D1)) {
                     list.Insert(Move::Make<CASTLING>(SQ_E1, SQ_C1));
                 }
             }
@@ -113,8 +193,7 @@ void GenerateKingMoves(const Position& pos, MoveList& list) {
     } else {
         if (pos.CanCastle(BLACK_OO)) {
             if (pos.PieceOn(SQ_F8) == NO_PIECE && pos.PieceOn(SQ_G8) == NO_PIECE) {
-                if (!MoveGen::IsSquareAttacked(pos, SQ_E8, WHITE) &&
-                    !MoveGen::IsSquareAttacked(pos, SQ_F8, WHITE)) {
+                if (!attacked(SQ_E8) && !attacked(SQ_F8)) {
                     list.Insert(Move::Make<CASTLING>(SQ_E8, SQ_G8));
                 }
             }
@@ -123,8 +202,7 @@ void GenerateKingMoves(const Position& pos, MoveList& list) {
         if (pos.CanCastle(BLACK_OOO)) {
             if (pos.PieceOn(SQ_D8) == NO_PIECE && pos.PieceOn(SQ_C8) == NO_PIECE &&
                 pos.PieceOn(SQ_B8) == NO_PIECE) {
-                if (!MoveGen::IsSquareAttacked(pos, SQ_E8, WHITE) &&
-                    !MoveGen::IsSquareAttacked(pos, SQ_D8, WHITE)) {
+                if (!attacked(SQ_E8) && !attacked(SQ_D8)) {
                     list.Insert(Move::Make<CASTLING>(SQ_E8, SQ_C8));
                 }
             }
@@ -132,16 +210,33 @@ void GenerateKingMoves(const Position& pos, MoveList& list) {
     }
 }
 
-template <Color Us>
-void GeneratePseudoMoves(const Position& pos, MoveList& list) {
-    const Bitboard target = ~pos.Pieces(Us);
+template <Color Us, MoveGen::GenType Type>
+void GenerateAllMoves(const Position& pos, MoveList& list, const AttackInfo* ai) {
+    using namespace MoveGen;
+
+    constexpr bool Checks = Type == QUIET_CHECKS;
+
+    // In double check only the king can move
+    const Bitboard checkers = pos.Checkers();
+    if (Type != EVASIONS || !(checkers & (checkers - 1))) {
+        Bitboard target;
+        if constexpr (Type == EVASIONS) {
+            target = Bitboards::Between(pos.square<KING>(Us), Lsb(checkers)) | checkers;
+        } else if constexpr (Type == CAPTURES) {
+            target = pos.Pieces(~Us);
+        } else if constexpr (Type == QUIETS || Checks) {
+            target = ~pos.Pieces();
+        } else {
+            target = ~pos.Pieces(Us);
+        }
 
-    GeneratePawnMoves<Us>(pos, list);
-    GenerateMoves<Us, KNIGHT>(pos, list, target);
-    GenerateMoves<Us, BISHOP>(pos, list, target);
-    GenerateMoves<Us, ROOK>(pos, list, target);
-    GenerateMoves<Us, QUEEN>(pos, list, target);
-    GenerateKingMoves<Us>(pos, list);
+        GeneratePawnMoves<Us, Type>(pos, list, target);
+        GenerateMoves<Us, KNIGHT, Checks>(pos, list, target, ai);
+        GenerateMoves<Us, BISHOP, Checks>(pos, list, target, ai);
+        GenerateMoves<Us, ROOK, Checks>(pos, list, target, ai);
+        GenerateMoves<Us, QUEEN, Checks>(pos, list, target, ai);
+    }
+    GenerateKingMoves<Us, Type>(pos, list, ai);
 }
 
 } // namespace
@@ -149,6 +244,8 @@ void GeneratePseudoMoves(const Position& pos, MoveList& list) {
 namespace MoveGen {
 
 bool IsSquareAttacked(const Position& pos, Square sq, Color attacker) {
+    Stats::Inc(Stats::SQUARE_ATTACKED_CALLS);
+
     const Bitboard attackers = pos.Pieces(attacker);
     const Bitboard occ = pos.Pieces();
 
@@ -177,10 +274,47 @@ bool IsSquareAttacked(const Position& pos, Square sq, Color attacker) {
     return false;
 }
 
-void GeneratePseudo(const Position& pos, MoveList& list) {
-    pos.SideToMove() == WHITE ? GeneratePseudoMoves<WHITE>(pos, list)
-                              : GeneratePseudoMoves<BLACK>(pos, list);
+namespace {
+
+template <GenType Type>
+void generate(const Position& pos, MoveList& list, const AttackInfo* ai) {
+    assert(Type != EVASIONS || pos.Checkers());
+    assert(Type != QUIET_CHECKS || !pos.Checkers());
+
+    [[maybe_unused]] const int before = list.Size();
+
+    pos.SideToMove() == WHITE ? GenerateAllMoves<WHITE, Type>(pos, list, ai)
+                              : GenerateAllMoves<BLACK, Type>(pos, list, ai);
+
+    Stats::Inc(Stats::GENERATE_CALLS);
+    Stats::Inc(Stats::MOVES_GENERATED, list.Size() - before);
+}
+
+} // namespace
+
+template <GenType Type>
+void Generate(const Position& pos, MoveList& list) {
+    generate<Type>(pos, list, nullptr);
+}
+
+template <GenType Type>
+void Generate(const Position& pos, const AttackInfo& ai, MoveList& list) {
+    generate<Type>(pos, list, &ai);
 }
 
+template void Generate<CAPTURES>(const Position& pos, MoveList& list);
+template void Generate<QUIETS>(const Position& pos, MoveList& list);
+template void Generate<EVASIONS>(const Position& pos, MoveList& list);
+template void Generate<QUIET_CHECKS>(const Position& pos, MoveList& list);
+template void Generate<ALL_MOVES>(const Position& pos, MoveList& list);
+
+template void Generate<CAPTURES>(const Position& pos, const AttackInfo& ai, MoveList& list);
+template void Generate<QUIETS>(const Position& pos, const AttackInfo& ai, MoveList& list);
+template void Generate<EVASIONS>(const Position& pos, const AttackInfo& ai, MoveList& list);
+template void Generate<QUIET_CHECKS>(const Position& pos, const AttackInfo& ai, MoveList& list);
+template void Generate<ALL_MOVES>(const Position& pos, const AttackInfo& ai, MoveList& list);
+
+void GeneratePseudo(const Position& pos, MoveList& list) { Generate<ALL_MOVES>(pos, list); }
+
 } // namespace MoveGen
 } // namespace Zugzwang
\ No newline at end of file
@@ -5,10 +5,28 @@
 namespace Zugzwang {
 
 class Position;
+struct AttackInfo;
 
 namespace MoveGen {
 
+enum GenType {
+    CAPTURES,     // captures, en passant and queen promotions
+    QUIETS,       // everything else: non-captures, castling and underpromotions
+    EVASIONS,     // only when in check: king moves, captures of the checker and interpositions
+    QUIET_CHECKS, // non-captures that give check, without castling and promotions; not in check
+    ALL_MOVES     // CAPTURES and QUIETS together
+};
+
 bool IsSquareAttacked(const Position& pos, Square sq, Color attacker);
+
+// Generates pseudo-legal moves of the given family, MakeMove() still rejects the illegal ones
+template <GenType Type>
+void Generate(const Position& pos, MoveList& list);
+
+// The same moves, taking the piece attacks from an AttackInfo computed for pos
+template <GenType Type>
+void Generate(const Position& pos, const AttackInfo& ai, MoveList& list);
+
 void GeneratePseudo(const Position& pos, MoveList& list);
 
 } // namespace MoveGen
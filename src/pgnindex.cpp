@@ -0,0 +1,489 @@
+#include "pch.h"
+#include "pgnindex.h"
+#include "bitboard.h"
+#include "mappedfile.h"
+#include "position.h"
+#include "uci.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+namespace Zugzwang {
+
+namespace PgnIndex {
+
+namespace {
+
+constexpr char Magic[8] = { 'Z', 'Z', 'P', 'G', 'N', 'I', 'X', '1' };
+
+// Threads take the file in pieces of about this size, each cut at the start of a game
+constexpr size_t ChunkBytes = 4 << 20;
+
+// A replayer sorts and merges its entries whenever they reach this many, and twice the size of
+// what is left after that
+constexpr size_t CompactEntries = 1 << 20;
+
+bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+PieceType pieceType(char c) {
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default: return ALL_PIECES;
+    }
+}
+
+Bitboard attacksFrom(PieceType pt, Square sq, Bitboard occupied) {
+    using namespace Bitboards;
+
+    switch (pt) {
+        case KNIGHT: return GetAttacks<KNIGHT>(sq);
+        case BISHOP: return GetAttacks<BISHOP>(sq, occupied);
+        case ROOK: return GetAttacks<ROOK>(sq, occupied);
+        case QUEEN: return GetAttacks<QUEEN>(sq, occupied);
+        default: return GetAttacks<KING>(sq);
+    }
+}
+
+bool entryLess(const IndexEntry& a, const IndexEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.move.Raw() < b.move.Raw();
+}
+
+// Sorts the entries and merges those of the same position and move
+void compact(std::vector<IndexEntry>& entries) {
+    std::sort(entries.begin(), entries.end(), entryLess);
+
+    size_t n = 0;
+    for (const auto& e : entries) {
+        if (n && entries[n - 1].key == e.key && entries[n - 1].move == e.move) {
+            entries[n - 1].wins += e.wins;
+            entries[n - 1].draws += e.draws;
+            entries[n - 1].losses += e.losses;
+        } else {
+            entries[n++] = e;
+        }
+    }
+    entries.resize(n);
+}
+
+// Where the pieces of the file handed to the threads start, the end of the file last. A piece
+// starts at an "[Event" tag, which opens every game.
+std::vector<size_t> chunkStarts(std::string_view text) {
+    std::vector<size_t> starts{ 0 };
+    for (size_t from = ChunkBytes; from < text.size();) {
+        const size_t found = text.find("\n[Event ", from);
+        if (found == std::string_view::npos) {
+            break;
+        }
+        starts.push_back(found + 1);
+        from = found + 1 + ChunkBytes;
+    }
+    starts.push_back(text.size());
+    return starts;
+}
+
+// Skips a variation, nested ones and comments included, from its opening parenthesis
+size_t skipVariation(std::string_view text, size_t i) {
+    int depth = 0;
+    for (; i < text.size(); ++i) {
+        if (text[i] == '{') {
+            i = text.find('}', i);
+            if (i == std::string_view::npos) {
+                return text.size();
+            }
+        } else if (text[i] == '(') {
+            ++depth;
+        } else if (text[i] == ')' && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+// Replays games on its own Position and collects one entry per indexed ply
+class Replayer {
+  public:
+    explicit Replayer(int maxPlies) : plies(maxPlies) {}
+
+    // Replays every game of a piece of the file that starts at a game's tags
+    void Run(std::string_view text) {
+        for (size_t i = 0; i < text.size();) {
+            if (isSpace(text[i])) {
+                ++i;
+            } else {
+                i = game(text, i);
+            }
+        }
+    }
+
+    std::vector<IndexEntry>& Entries() { return entries; }
+    uint64_t Games() const { return games; }
+    uint64_t Skipped() const { return skipped; }
+    uint64_t Positions() const { return positions; }
+
+  private:
+    struct Ply {
+        Key key;
+        Move move;
+        Color side;
+    };
+
+    size_t game(std::string_view text, size_t i);
+    void commit(int whiteResult);
+
+    // A Position holds the whole move history, keep it off the thread's stack
+    std::unique_ptr<Position> pos = std::make_unique<Position>();
+    std::vector<Ply> line; // the indexed plies of the current game
+    std::vector<IndexEntry> entries;
+    size_t compactAt = CompactEntries;
+    int plies;
+    uint64_t games = 0;
+    uint64_t skipped = 0;
+    uint64_t positions = 0;
+};
+
+// Reads the tags and the movetext of the game at offset i and returns the offset after it
+size_t Replayer::game(std::string_view text, size_t i) {
+    std::string_view fen, result;
+
+    while (true) {
+        while (i < text.size() && isSpace(text[i])) {
+            ++i;
+        }
+        if (i == text.size() || text[i] != '[') {
+            break;
+        }
+
+        // [Name "value"]
+        const size_t eol = std::min(text.find('\n', i), text.size());
+        const std::string_view tag = text.substr(i, eol - i);
+        const size_t open = tag.find('"'), close = tag.rfind('"');
+        if (open != std::string_view::npos && close > open) {
+            const std::string_view name = tag.substr(1, tag.find(' ') - 1);
+            const std::string_view value = tag.substr(open + 1, close - open - 1);
+            if (name == "FEN") {
+                fen = value;
+            } else if (name == "Result") {
+                result = value;
+            }
+        }
+        i = eol;
+    }
+
+    bool ok = pos->ParseFen(fen.empty() ? StartFEN : fen);
+    line.clear();
+
+    while (i < text.size()) {
+        const char c = text[i];
+        if (isSpace(c) || c == ')' || c == '}') {
+            ++i;
+            continue;
+        }
+        if (c == '[') {
+            break; // the next game, this one had no termination marker
+        }
+        if (c == '{') {
+            i = std::min(text.find('}', i), text.size());
+            continue;
+        }
+        if (c == ';' || (c == '%' && (i == 0 || text[i - 1] == '\n'))) {
+            i = std::min(text.find('\n', i), text.size());
+            continue;
+        }
+        if (c == '(') {
+            i = skipVariation(text, i);
+            continue;
+        }
+
+        const size_t start = i;
+        while (i < text.size() && !isSpace(text[i]) && text[i] != '{' && text[i] != '(' &&
+               text[i] != ')' && text[i] != ';') {
+            ++i;
+        }
+        std::string_view token = text.substr(start, i - start);
+
+        if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+            result = token;
+            break;
+        }
+        if (c == '$' || token == "e.p.") {
+            continue;
+        }
+
+        // Move numbers such as "12." or "12...", which may run into the move as in "12.e4"
+        const size_t digits = token.find_first_not_of("0123456789");
+        if (digits != 0 && digits != std::string_view::npos && token[digits] == '.') {
+            token.remove_prefix(std::min(token.find_first_not_of('.', digits), token.size()));
+        }
+        if (token.empty() || !ok || int(line.size()) >= plies) {
+            continue;
+        }
+
+        const Move move = ParseSan(*pos, token);
+        if (!move) {
+            ok = false;
+            continue;
+        }
+        line.push_back({ pos->PosKey(), move, pos->SideToMove() });
+        pos->MakeMove(move);
+    }
+
+    if (!ok || (result != "1-0" && result != "0-1" && result != "1/2-1/2")) {
+        ++skipped;
+    } else {
+        commit(result == "1-0" ? 1 : result == "0-1" ? -1 : 0);
+    }
+    return i;
+}
+
+void Replayer::commit(int whiteResult) {
+    for (const auto& ply : line) {
+        const int r = ply.side == WHITE ? whiteResult : -whiteResult;
+        entries.push_back({ ply.key, ply.move, 0, r > 0, r == 0, r < 0 });
+    }
+    ++games;
+    positions += line.size();
+
+    if (entries.size() >= compactAt) {
+        compact(entries);
+        compactAt = std::max(CompactEntries, 2 * entries.size());
+    }
+}
+
+} // namespace
+
+Move ParseSan(const Position& pos, std::string_view san) {
+    using namespace Bitboards;
+
+    // Check and mate signs and annotations play no part
+    while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos) {
+        san.remove_suffix(1);
+    }
+
+    const Color us = pos.SideToMove();
+    const Rank backRank = RelativeRank(us, RANK_1);
+    const bool kingSide = san == "O-O" || san == "0-0";
+    if (kingSide || san == "O-O-O" || san == "0-0-0") {
+        const Square to = MakeSquare(kingSide ? FILE_G : FILE_C, backRank);
+        const Move move = Move::Make<CASTLING>(MakeSquare(FILE_E, backRank), to);
+        return pos.IsLegal(move) ? move : Move::None();
+    }
+
+    // "e8=Q", or "e8Q" as some programs write it
+    PieceType promotion = ALL_PIECES;
+    if (const size_t eq = san.find('='); eq != std::string_view::npos) {
+        promotion = eq + 1 < san.size() ? pieceType(san[eq + 1]) : KING;
+        san = san.substr(0, eq);
+    } else if (san.size() >= 3 && san[0] >= 'a' && san[0] <= 'h' && pieceType(san.back())) {
+        promotion = pieceType(san.back());
+        san.remove_suffix(1);
+    }
+    if (promotion == KING) {
+        return Move::None();
+    }
+
+    PieceType pt = PAWN;
+    if (!san.empty() && (pieceType(san[0]) || san[0] == 'P')) {
+        pt = san[0] == 'P' ? PAWN : pieceType(san[0]);
+        san.remove_prefix(1);
+    }
+
+    if (san.size() < 2 || san[san.size() - 2] < 'a' || san[san.size() - 2] > 'h' ||
+        san.back() < '1' || san.back() > '8') {
+        return Move::None();
+    }
+    const Square to = MakeSquare(File(san[san.size() - 2] - 'a'), Rank(san.back() - '1'));
+    san.remove_suffix(2);
+
+    // What is left tells the piece apart and may mark a capture, as in "Nbxd7" or "R1a3"
+    int fromFile = -1, fromRank = -1;
+    for (const char c : san) {
+        if (c >= 'a' && c <= 'h') {
+            fromFile = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            fromRank = c - '1';
+        } else if (c != 'x' && c != ':' && c != '-') {
+            return Move::None();
+        }
+    }
+
+    if (pt == PAWN) {
+        const Direction up = PawnPush(us);
+        if (RelativeRank(us, RankOf(to)) < RANK_3) {
+            return Move::None();
+        }
+
+        Move move;
+        if (fromFile < 0 || fromFile == FileOf(to)) {
+            // A push, two squares when the square behind is empty
+            Square from = to - up;
+            if (pos.PieceOn(from) == NO_PIECE && RelativeRank(us, RankOf(to)) == RANK_4) {
+                from -= up;
+            }
+            move = promotion ? Move::Make<PROMOTION>(from, to, promotion) : Move(from, to);
+        } else {
+            const Square from = MakeSquare(File(fromFile), RankOf(to - up));
+            if (promotion) {
+                move = Move::Make<PROMOTION>(from, to, promotion);
+            } else if (to == pos.EpSuare()) {
+                move = Move::Make<EN_PASSANT>(from, to);
+            } else {
+                move = Move(from, to);
+            }
+        }
+        return pos.IsLegal(move) ? move : Move::None();
+    }
+
+    if (promotion) {
+        return Move::None();
+    }
+
+    // The pieces of that type that reach the destination, which it reaches from them in turn
+    Bitboard candidates = pos.Pieces(us, pt) & attacksFrom(pt, to, pos.Pieces());
+    if (fromFile >= 0) {
+        candidates &= FileABB << fromFile;
+    }
+    if (fromRank >= 0) {
+        candidates &= Rank1BB << (8 * fromRank);
+    }
+
+    Move found = Move::None();
+    while (candidates) {
+        const Move move(PopLsb(candidates), to);
+        if (pos.IsLegal(move)) {
+            if (found) {
+                return Move::None(); // ambiguous
+            }
+            found = move;
+        }
+    }
+    return found;
+}
+
+bool Build(const Options& options) {
+    using namespace std::chrono;
+
+    const MappedFile file(options.input);
+    if (!file.IsOpen()) {
+        std::cout << "Unable to open '" << options.input << "'\n";
+        return false;
+    }
+    file.Advise(MappedFile::SEQUENTIAL);
+
+    const std::string output = options.output.empty() ? options.input + ".idx" : options.output;
+    const std::string_view text(file.Data(), file.Size());
+    const int threadCount = std::max(options.threads, 1);
+    const int plies = options.plies > 0 ? std::min(options.plies, MAX_PLIES - 1) : MAX_PLIES - 1;
+
+    const auto start = steady_clock::now();
+
+    const std::vector<size_t> starts = chunkStarts(text);
+    std::atomic<size_t> nextChunk{ 0 };
+
+    std::vector<std::unique_ptr<Replayer>> replayers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        replayers.push_back(std::make_unique<Replayer>(plies));
+        threads.emplace_back([&, &replayer = *replayers.back()] {
+            for (size_t c; (c = nextChunk.fetch_add(1)) + 1 < starts.size();) {
+                replayer.Run(text.substr(starts[c], starts[c + 1] - starts[c]));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const auto replayed = steady_clock::now();
+
+    uint64_t games = 0, skipped = 0, positions = 0;
+    std::vector<IndexEntry> entries;
+    for (auto& replayer : replayers) {
+        games += replayer->Games();
+        skipped += replayer->Skipped();
+        positions += replayer->Positions();
+
+        std::vector<IndexEntry> part = std::move(replayer->Entries());
+        entries.insert(entries.end(), part.begin(), part.end());
+    }
+    compact(entries);
+
+    IndexHeader header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.count = entries.size();
+
+    std::ofstream out(output, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+    out.close();
+    if (!out) {
+        std::cout << "Unable to write '" << output << "'\n";
+        return false;
+    }
+
+    const auto built = steady_clock::now();
+
+    uint64_t keys = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        keys += i == 0 || entries[i].key != entries[i - 1].key;
+    }
+
+    const double replaySecs = std::max(duration<double>(replayed - start).count(), 1e-9);
+    std::cout << "Replayed " << games << " games (" << skipped << " skipped) in "
+              << uint64_t(replaySecs * 1000) << " ms on " << threadCount << " threads: "
+              << uint64_t(games / replaySecs) << " games/sec, "
+              << uint64_t(text.size() / replaySecs / (1 << 20)) << " MB/sec\n";
+    std::cout << "Index of " << positions << " plies, " << entries.size() << " moves from " << keys
+              << " positions built and written to '" << output << "' in "
+              << duration_cast<milliseconds>(built - replayed).count() << " ms\n";
+    return true;
+}
+
+void Probe(const std::string& file, const Position& pos) {
+    const MappedFile index(file);
+    IndexHeader header{};
+    if (index.IsOpen() && index.Size() >= sizeof(header)) {
+        std::memcpy(&header, index.Data(), sizeof(header));
+    }
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+        index.Size() != sizeof(header) + header.count * sizeof(IndexEntry)) {
+        std::cout << "Unable to read the index '" << file << "'\n";
+        return;
+    }
+
+    const auto* begin = reinterpret_cast<const IndexEntry*>(index.Data() + sizeof(header));
+    const auto* end = begin + header.count;
+    const Key key = pos.PosKey();
+    const auto* first =
+        std::lower_bound(begin, end, key, [](const IndexEntry& e, Key k) { return e.key < k; });
+    const auto* last =
+        std::upper_bound(first, end, key, [](Key k, const IndexEntry& e) { return k < e.key; });
+
+    std::vector<IndexEntry> moves(first, last);
+    auto gamesOf = [](const IndexEntry& e) { return uint64_t(e.wins) + e.draws + e.losses; };
+    std::stable_sort(moves.begin(), moves.end(),
+                     [&](const auto& a, const auto& b) { return gamesOf(a) > gamesOf(b); });
+
+    uint64_t total = 0;
+    for (const auto& e : moves) {
+        total += gamesOf(e);
+    }
+    std::cout << total << " games, " << moves.size() << " moves\n";
+
+    for (const auto& e : moves) {
+        const uint64_t n = gamesOf(e);
+        std::cout << UCI::FormatMove(e.move) << " games " << n << " +" << e.wins << " =" << e.draws
+                  << " -" << e.losses << " score " << std::fixed << std::setprecision(1)
+                  << (e.wins + e.draws / 2.0) * 100 / n << "%\n"
+                  << std::defaultfloat;
+    }
+}
+
+} // namespace PgnIndex
+
+} // namespace Zugzwang
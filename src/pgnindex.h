@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <string_view>
+
+namespace Zugzwang {
+
+class Position;
+
+namespace PgnIndex {
+
+// One move played from one position with the results of the games it was played in, from the
+// point of view of the side that played it. 24 bytes, written in host byte order.
+struct IndexEntry {
+    Key key; // Position::PosKey() before the move
+    Move move;
+    uint16_t padding;
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+};
+
+static_assert(sizeof(IndexEntry) == 24);
+
+// An index file is this header followed by the entries sorted by key and then by move, so the
+// moves of a position sit next to each other and a binary search over the mapped file finds them
+struct IndexHeader {
+    char magic[8];  // "ZZPGNIX1"
+    uint64_t count; // entries that follow
+};
+
+static_assert(sizeof(IndexHeader) == 16);
+
+struct Options {
+    std::string input;
+    std::string output; // the input name with ".idx" appended when empty
+    int threads = 1;
+    int plies = 40; // indexed from the start of each game, 0 for whole games
+};
+
+// Replays the games of a PGN file on 'threads' threads, reading it through a memory mapping, and
+// writes the index of the positions of their first 'plies' plies. Games without a result, or with
+// a move among those plies that does not parse, are left out. Returns false if a file cannot be
+// read or written.
+bool Build(const Options& options);
+
+// Prints the indexed moves of pos from an index file, most played first
+void Probe(const std::string& file, const Position& pos);
+
+// The legal move of pos written in SAN, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O", or Move::None()
+// if there is none or more than one. Finds it from the destination with reverse attacks and
+// Position::IsLegal() rather than by generating the moves.
+Move ParseSan(const Position& pos, std::string_view san);
+
+} // namespace PgnIndex
+
+} // namespace Zugzwang
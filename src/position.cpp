@@ -2,6 +2,8 @@
 #include "bitboard.h"
 #include "movegen.h"
 #include "position.h"
+#include "stats.h"
+#include <limits>
 
 namespace Zugzwang {
 namespace {
@@ -21,8 +23,7 @@ constexpr int CastlePerm[64] = {
 };
 // clang-format on
 
-uint64_t seed = 1804289383ULL;
-uint64_t rand64() {
+uint64_t rand64(uint64_t& seed) {
     uint64_t x = seed;
     x ^= x >> 12;
     x ^= x << 25;
@@ -37,192 +38,703 @@ Key side;
 
 } // namespace
 
-Position::Position() {
+void Position::Init() {
+    uint64_t seed = 1804289383ULL;
+
     for (int i = 0; i < PIECE_NB; ++i) {
         for (Square j = SQ_A1; j < SQUARE_NB; ++j) {
-            psq[i][j] = rand64();
+            psq[i][j] = rand64(seed);
         }
     }
-    side = rand64();
+    side = rand64(seed);
     for (int i = 0; i < CASTLING_RIGHT_NB; ++i) {
-        castling[i] = rand64();
+        castling[i] = rand64(seed);
     }
 }
 
+Key Position::KeySignature() {
+    Key signature = side;
+    auto fold = [&](Key k) { signature = (signature ^ k) * 0x9E3779B97F4A7C15ULL; };
+
+    for (int i = 0; i < PIECE_NB; ++i) {
+        for (Square j = SQ_A1; j < SQUARE_NB; ++j) {
+            fold(psq[i][j]);
+        }
+    }
+    for (int i = 0; i < CASTLING_RIGHT_NB; ++i) {
+        fold(castling[i]);
+    }
+    return signature;
+}
+
 void Position::putPiece(Piece piece, Square sq) {
     assert(piece != NO_PIECE);
 
-    board[sq] = piece;
-    posKey ^= psq[piece][sq];
-    pieceNb[piece]++;
+    st().board[sq] = piece;
+    st().posKey ^= psq[piece][sq];
+    st().pieceNb[piece]++;
 
-    byColorBB[ColorOf(piece)] |= sq;
-    byTypeBB[ALL_PIECES] |= byTypeBB[TypeOf(piece)] |= sq;
+    st().byColorBB[ColorOf(piece)] |= sq;
+    st().byTypeBB[ALL_PIECES] |= st().byTypeBB[TypeOf(piece)] |= sq;
 }
 
 void Position::removePiece(Square sq) {
-    Piece piece = board[sq];
+    Piece piece = st().board[sq];
     assert(piece != NO_PIECE);
 
-    posKey ^= psq[piece][sq];
-    board[sq] = NO_PIECE;
+    st().posKey ^= psq[piece][sq];
+    st().board[sq] = NO_PIECE;
 
-    byTypeBB[ALL_PIECES] ^= sq;
-    byTypeBB[TypeOf(piece)] ^= sq;
-    byColorBB[ColorOf(piece)] ^= sq;
+    st().byTypeBB[ALL_PIECES] ^= sq;
+    st().byTypeBB[TypeOf(piece)] ^= sq;
+    st().byColorBB[ColorOf(piece)] ^= sq;
 
-    pieceNb[piece]--;
+    st().pieceNb[piece]--;
 }
 
 void Position::movePiece(Square from, Square to) {
-    Piece piece = board[from];
+    Piece piece = st().board[from];
     assert(piece != NO_PIECE);
 
     Bitboard fromTo = from | to;
 
-    posKey ^= psq[piece][from];
-    posKey ^= psq[piece][to];
-    board[from] = NO_PIECE;
-    board[to] = piece;
+    st().posKey ^= psq[piece][from];
+    st().posKey ^= psq[piece][to];
+    st().board[from] = NO_PIECE;
+    st().board[to] = piece;
 
-    byTypeBB[ALL_PIECES] ^= fromTo;
-    byTypeBB[TypeOf(piece)] ^= fromTo;
-    byColorBB[ColorOf(piece)] ^= fromTo;
+    st().byTypeBB[ALL_PIECES] ^= fromTo;
+    st().byTypeBB[TypeOf(piece)] ^= fromTo;
+    st().byColorBB[ColorOf(piece)] ^= fromTo;
 }
 
 void Position::generatePosKey() {
     for (Square i = SQ_A1; i < SQUARE_NB; ++i) {
-        Piece piece = board[i];
+        Piece piece = st().board[i];
         if (piece != NO_PIECE) {
-            posKey ^= psq[piece][i];
+            st().posKey ^= psq[piece][i];
+        }
+    }
+
+    if (st().sideToMove == WHITE) {
+        st().posKey ^= side;
+    }
+
+    if (st().epSquare != SQ_NONE) {
+        st().posKey ^= psq[NO_PIECE][st().epSquare];
+    }
+
+    st().posKey ^= castling[st().castlingRights];
+}
+
+Bitboard Position::AttackersTo(Square sq, Bitboard occupied) const {
+    using namespace Bitboards;
+
+    return (GetAttacks<PAWN>(sq, 0, BLACK) & Pieces(WHITE, PAWN)) |
+        (GetAttacks<PAWN>(sq, 0, WHITE) & Pieces(BLACK, PAWN)) |
+        (GetAttacks<KNIGHT>(sq) & Pieces(KNIGHT)) |
+        (GetAttacks<ROOK>(sq, occupied) & Pieces(ROOK, QUEEN)) |
+        (GetAttacks<BISHOP>(sq, occupied) & Pieces(BISHOP, QUEEN)) |
+        (GetAttacks<KING>(sq) & Pieces(KING));
+}
+
+// Returns the pieces of either color that are the only piece between sq and one of the given
+// sliders. The sliders pinning a piece of sq's color are stored in pinners.
+Bitboard Position::sliderBlockers(Bitboard sliders, Square sq, Bitboard& pinners) const {
+    using namespace Bitboards;
+
+    Bitboard blockers = 0;
+    pinners = 0;
+
+    Bitboard snipers = ((PseudoAttacks(ROOK, sq) & Pieces(ROOK, QUEEN)) |
+                           (PseudoAttacks(BISHOP, sq) & Pieces(BISHOP, QUEEN))) &
+        sliders;
+    const Bitboard occupancy = Pieces() ^ snipers;
+
+    while (snipers) {
+        const Square sniperSq = PopLsb(snipers);
+        const Bitboard b = Between(sq, sniperSq) & occupancy;
+
+        if (b && !(b & (b - 1))) {
+            blockers |= b;
+            if (b & Pieces(ColorOf(st().board[sq]))) {
+                pinners |= sniperSq;
+            }
+        }
+    }
+    return blockers;
+}
+
+void Position::setCheckInfo() {
+    using namespace Bitboards;
+
+    CheckInfo& ci = checkInfo();
+    const Color us = st().sideToMove, them = ~us;
+    const Square ksq = square<KING>(them);
+
+    ci.checkers = AttackersTo(square<KING>(us), Pieces()) & Pieces(them);
+    ci.blockersForKing[WHITE] =
+        sliderBlockers(Pieces(BLACK), square<KING>(WHITE), ci.pinners[BLACK]);
+    ci.blockersForKing[BLACK] =
+        sliderBlockers(Pieces(WHITE), square<KING>(BLACK), ci.pinners[WHITE]);
+
+    ci.checkSquares[PAWN] = GetAttacks<PAWN>(ksq, 0, them);
+    ci.checkSquares[KNIGHT] = GetAttacks<KNIGHT>(ksq);
+    ci.checkSquares[BISHOP] = GetAttacks<BISHOP>(ksq, Pieces());
+    ci.checkSquares[ROOK] = GetAttacks<ROOK>(ksq, Pieces());
+    ci.checkSquares[QUEEN] = ci.checkSquares[BISHOP] | ci.checkSquares[ROOK];
+    ci.checkSquares[KING] = 0;
+}
+
+// Decides whether a pseudo-legal move leaves the king safe before it is made, from the check
+// info of the current ply
+bool Position::leavesKingSafe(const Move& move) const {
+    using namespace Bitboards;
+
+    const CheckInfo& ci = checkInfo();
+    const Color us = st().sideToMove;
+    const Square from = move.FromSq();
+    const Square to = move.ToSq();
+    const Square ksq = square<KING>(us);
+
+    // The generator already rejects castling out of or through check
+    if (from == ksq) {
+        return !(AttackersTo(to, Pieces() ^ from) & Pieces(~us));
+    }
+
+    // Removing two pawns from a rank can expose the king, so look at the resulting board
+    if (move.TypeOf() == EN_PASSANT) {
+        const Square capSq = MakeSquare(FileOf(to), RankOf(from));
+        const Bitboard occupied = (Pieces() ^ from ^ capSq) | to;
+        return !(AttackersTo(ksq, occupied) & Pieces(~us) & ~SquareBb(capSq));
+    }
+
+    // Out of a single check only by capturing the checker or blocking, a double check needs a
+    // king move
+    if (ci.checkers) {
+        if (ci.checkers & (ci.checkers - 1)) {
+            return false;
+        }
+        if (!((Between(ksq, Lsb(ci.checkers)) | ci.checkers) & to)) {
+            return false;
+        }
+    }
+
+    return !(ci.blockersForKing[us] & from) || (Line(from, ksq) & to);
+}
+
+bool Position::IsPseudoLegal(const Move& move) const {
+    using namespace Bitboards;
+
+    if (!move) {
+        return false;
+    }
+
+    const Color us = st().sideToMove;
+    const Square from = move.FromSq();
+    const Square to = move.ToSq();
+    const Bitboard occupied = Pieces();
+
+    if (!(Pieces(us) & from) || (Pieces(us) & to)) {
+        return false;
+    }
+    // Only promotions fill in the piece bits
+    if (move.TypeOf() != PROMOTION && move.PromotionType() != KNIGHT) {
+        return false;
+    }
+
+    const PieceType pt = TypeOf(st().board[from]);
+
+    if (move.TypeOf() == CASTLING) {
+        // The generator's conditions: the right, nothing between king and rook, and a king that
+        // is not in check and does not cross an attacked square. Where it lands is for
+        // leavesKingSafe() to see.
+        const bool kingSide = FileOf(to) == FILE_G;
+        const Rank rank = RankOf(from);
+        const CastlingRights cr = us == WHITE ? (kingSide ? WHITE_OO : WHITE_OOO)
+                                              : (kingSide ? BLACK_OO : BLACK_OOO);
+        if (pt != KING || from != MakeSquare(FILE_E, RelativeRank(us, RANK_1)) ||
+            RankOf(to) != rank || (!kingSide && FileOf(to) != FILE_C) || !CanCastle(cr)) {
+            return false;
+        }
+
+        const Square rookFrom = MakeSquare(kingSide ? FILE_H : FILE_A, rank);
+        const Square crossed = MakeSquare(kingSide ? FILE_F : FILE_D, rank);
+        return !(Between(from, rookFrom) & occupied) &&
+            !MoveGen::IsSquareAttacked(*this, from, ~us) &&
+            !MoveGen::IsSquareAttacked(*this, crossed, ~us);
+    }
+
+    if (pt != PAWN) {
+        if (move.TypeOf() != NORMAL) {
+            return false;
+        }
+        switch (pt) {
+            case KNIGHT: return GetAttacks<KNIGHT>(from) & to;
+            case BISHOP: return GetAttacks<BISHOP>(from, occupied) & to;
+            case ROOK: return GetAttacks<ROOK>(from, occupied) & to;
+            case QUEEN: return GetAttacks<QUEEN>(from, occupied) & to;
+            default: return GetAttacks<KING>(from) & to;
+        }
+    }
+
+    if (move.TypeOf() == EN_PASSANT) {
+        return to == st().epSquare && (GetAttacks<PAWN>(from, 0, us) & to);
+    }
+
+    // A pawn reaching the last rank must promote and only there may it
+    if ((RelativeRank(us, RankOf(to)) == RANK_8) != (move.TypeOf() == PROMOTION)) {
+        return false;
+    }
+
+    const Direction up = PawnPush(us);
+    if (GetAttacks<PAWN>(from, 0, us) & Pieces(~us) & to) {
+        return true;
+    }
+    if (to == from + up) {
+        return !(occupied & to);
+    }
+    return to == from + up + up && RelativeRank(us, RankOf(from)) == RANK_2 &&
+        !(occupied & (from + up)) && !(occupied & to);
+}
+
+bool Position::IsLegal(const Move& move) const {
+    return IsPseudoLegal(move) && leavesKingSafe(move);
+}
+
+bool Position::IsRepetition() const {
+    const int end = std::max(historyPly - st().rule50, 0);
+
+    for (int ply = historyPly - 4; ply >= end; ply -= 2) {
+#if defined(USE_COPY_MAKE)
+        if (states[ply].posKey == st().posKey) {
+#else
+        if (history[ply].posKey == st().posKey) {
+#endif
+            return true;
         }
     }
+    return false;
+}
 
-    if (sideToMove == WHITE) {
-        posKey ^= side;
+bool Position::GivesCheck(const Move& move) const {
+    using namespace Bitboards;
+
+    const CheckInfo& ci = checkInfo();
+    const Color us = st().sideToMove;
+    const Square from = move.FromSq();
+    const Square to = move.ToSq();
+    const Square ksq = square<KING>(~us);
+
+    // Direct check
+    if (ci.checkSquares[TypeOf(st().board[from])] & to) {
+        return true;
     }
 
-    if (epSquare != SQ_NONE) {
-        posKey ^= psq[NO_PIECE][epSquare];
+    // Discovered check, unless the piece keeps blocking the same line
+    if ((ci.blockersForKing[~us] & from) && !(Line(from, ksq) & to)) {
+        return true;
     }
 
-    posKey ^= castling[castlingRights];
+    switch (move.TypeOf()) {
+        case PROMOTION: {
+            const Bitboard occupied = Pieces() ^ from;
+            switch (move.PromotionType()) {
+                case KNIGHT: return GetAttacks<KNIGHT>(to) & ksq;
+                case BISHOP: return GetAttacks<BISHOP>(to, occupied) & ksq;
+                case ROOK: return GetAttacks<ROOK>(to, occupied) & ksq;
+                default: return GetAttacks<QUEEN>(to, occupied) & ksq;
+            }
+        }
+        case EN_PASSANT: {
+            // The captured pawn may have been the only piece between a slider and the king
+            const Square capSq = MakeSquare(FileOf(to), RankOf(from));
+            const Bitboard occupied = (Pieces() ^ from ^ capSq) | to;
+            return (GetAttacks<ROOK>(ksq, occupied) & Pieces(us, ROOK, QUEEN)) |
+                (GetAttacks<BISHOP>(ksq, occupied) & Pieces(us, BISHOP, QUEEN));
+        }
+        case CASTLING: {
+            // Only the rook can check, possibly along the rank the king just left
+            const bool kingSide = FileOf(to) == FILE_G;
+            const Square rookFrom = MakeSquare(kingSide ? FILE_H : FILE_A, RankOf(from));
+            const Square rookTo = MakeSquare(kingSide ? FILE_F : FILE_D, RankOf(from));
+            const Bitboard occupied = (Pieces() ^ from ^ rookFrom) | to | rookTo;
+            return GetAttacks<ROOK>(rookTo, occupied) & ksq;
+        }
+        default: return false;
+    }
 }
 
 void Position::reset() {
+    historyPly = 0;
+
     for (Square i = SQ_A1; i < SQUARE_NB; ++i) {
-        board[i] = NO_PIECE;
+        st().board[i] = NO_PIECE;
     }
 
     for (int i = 0; i < PIECE_NB; ++i) {
-        pieceNb[i] = 0;
+        st().pieceNb[i] = 0;
     }
 
     for (int i = 0; i < PIECE_TYPE_NB; ++i) {
-        byTypeBB[i] = 0ULL;
+        st().byTypeBB[i] = 0ULL;
     }
 
-    byColorBB[WHITE] = byColorBB[BLACK] = 0ULL;
-    sideToMove = WHITE;
-    epSquare = SQ_NONE;
-    rule50 = 0;
-    gamePly = 0;
-    castlingRights = NO_CASTLING;
-    posKey = 0ULL;
+    st().byColorBB[WHITE] = st().byColorBB[BLACK] = 0ULL;
+    st().sideToMove = WHITE;
+    st().epSquare = SQ_NONE;
+    st().rule50 = 0;
+    st().gamePly = 0;
+    st().castlingRights = NO_CASTLING;
+    st().posKey = 0ULL;
 }
 
 void Position::updateListsBitboards() {
     for (Square sq = SQ_A1; sq < SQUARE_NB; ++sq) {
-        const Piece piece = board[sq];
+        const Piece piece = st().board[sq];
 
         if (piece != NO_PIECE) {
-            byColorBB[ColorOf(piece)] |= sq;
-            byTypeBB[ALL_PIECES] |= byTypeBB[TypeOf(piece)] |= sq;
+            st().byColorBB[ColorOf(piece)] |= sq;
+            st().byTypeBB[ALL_PIECES] |= st().byTypeBB[TypeOf(piece)] |= sq;
 
-            pieceNb[piece]++;
+            st().pieceNb[piece]++;
         }
     }
 }
 
-void Position::ParseFen(const std::string& fen) {
+bool Position::ParseFen(std::string_view fen) {
     reset();
 
-    unsigned char col, row, token;
-    size_t idx;
-    Square sq = SQ_A8;
-    std::istringstream ss(fen);
-
-    ss >> std::noskipws;
+    size_t idx = 0;
+    auto atEnd = [&] { return idx >= fen.size(); };
+    auto skipSpaces = [&] {
+        const size_t start = idx;
+        while (!atEnd() && fen[idx] == ' ') {
+            ++idx;
+        }
+        return idx > start;
+    };
+    auto parseNumber = [&](int& value) {
+        const char* first = fen.data() + idx;
+        const auto [ptr, ec] = std::from_chars(first, fen.data() + fen.size(), value);
+        idx += ptr - first;
+        return ec == std::errc() && value >= 0;
+    };
 
     // 1. Piece placement
-    while ((ss >> token) && !isspace(token)) {
-        if (isdigit(token)) {
-            sq += (token - '0') * EAST;
+    Rank rank = RANK_8;
+    File file = FILE_A;
+    for (; !atEnd() && fen[idx] != ' '; ++idx) {
+        const char token = fen[idx];
+
+        if (token >= '1' && token <= '8') {
+            file = File(file + token - '0');
+            if (file > FILE_NB) {
+                return false;
+            }
         } else if (token == '/') {
-            sq += 2 * SOUTH;
+            if (file != FILE_NB || rank == RANK_1) {
+                return false;
+            }
+            --rank;
+            file = FILE_A;
         } else {
-            const char* p = std::strchr(PieceToChar, token);
-            if (p) {
-                idx = p - PieceToChar;
-                board[sq] = Piece(idx);
-                ++sq;
+            const char* p = token ? std::strchr(PieceToChar, token) : nullptr;
+            if (!p || *p == ' ' || file >= FILE_NB) {
+                return false;
             }
+
+            st().board[MakeSquare(file, rank)] = Piece(p - PieceToChar);
+            ++file;
         }
     }
+    if (rank != RANK_1 || file != FILE_NB || !skipSpaces()) {
+        return false;
+    }
 
     // 2. Active color
-    ss >> token;
-    sideToMove = (token == 'w' ? WHITE : BLACK);
-    ss >> token;
+    if (atEnd() || (fen[idx] != 'w' && fen[idx] != 'b')) {
+        return false;
+    }
+    st().sideToMove = (fen[idx++] == 'w' ? WHITE : BLACK);
+    if (!skipSpaces()) {
+        return false;
+    }
 
     // 3. Castling availability
-    while ((ss >> token) && !isspace(token)) {
-        switch (token) {
-            case 'K': castlingRights |= WHITE_OO; break;
-            case 'k': castlingRights |= BLACK_OO; break;
-            case 'Q': castlingRights |= WHITE_OOO; break;
-            case 'q': castlingRights |= BLACK_OOO; break;
+    if (!atEnd() && fen[idx] == '-') {
+        ++idx;
+    } else {
+        for (; !atEnd() && fen[idx] != ' '; ++idx) {
+            switch (fen[idx]) {
+                case 'K': st().castlingRights |= WHITE_OO; break;
+                case 'k': st().castlingRights |= BLACK_OO; break;
+                case 'Q': st().castlingRights |= WHITE_OOO; break;
+                case 'q': st().castlingRights |= BLACK_OOO; break;
+                default: return false;
+            }
         }
     }
+    if (st().castlingRights == NO_CASTLING && fen[idx - 1] != '-') {
+        return false;
+    }
+    if (!skipSpaces()) {
+        return false;
+    }
 
     // 4. En passant square
-    if (((ss >> col) && (col >= 'a' && col <= 'h')) &&
-        ((ss >> row) && (row == (sideToMove == WHITE ? '6' : '3')))) {
-        epSquare = MakeSquare(File(col - 'a'), Rank(row - '1'));
+    if (!atEnd() && fen[idx] == '-') {
+        ++idx;
+    } else {
+        if (fen.size() - idx < 2) {
+            return false;
+        }
+        const char col = fen[idx++];
+        const char row = fen[idx++];
+        if (col < 'a' || col > 'h' || row != (st().sideToMove == WHITE ? '6' : '3')) {
+            return false;
+        }
+        st().epSquare = MakeSquare(File(col - 'a'), Rank(row - '1'));
     }
 
-    // 5. Halfmove clock (rule50)
-    ss >> std::skipws >> rule50 >> gamePly;
+    // 5. Halfmove clock (rule50) and fullmove number, both optional
+    int fullMove = 1;
+    if (skipSpaces() && !atEnd()) {
+        if (!parseNumber(st().rule50)) {
+            return false;
+        }
+        if (skipSpaces() && !atEnd() && !parseNumber(fullMove)) {
+            return false;
+        }
+        skipSpaces();
+    }
+    if (!atEnd()) {
+        return false;
+    }
 
     // Convert from fullmove starting from 1 to internal ply count
-    gamePly = std::max(2 * (gamePly - 1), 0) + (sideToMove == BLACK);
+    st().gamePly = std::max(2 * (fullMove - 1), 0) + (st().sideToMove == BLACK);
 
     generatePosKey();
     updateListsBitboards();
+
+    if (!isValid()) {
+        return false;
+    }
+    setCheckInfo();
+    return true;
+}
+
+// The checks that ParseFen() and Unpack() share, once the pieces and the state are in place
+bool Position::isValid() const {
+    if (Pieces(PAWN) & (Rank1BB | Rank8BB)) {
+        return false;
+    }
+
+    // The en passant square is behind a pawn that has just been pushed two squares
+    if (st().epSquare != SQ_NONE) {
+        const Square ep = EpSuare();
+        const Direction push = st().sideToMove == WHITE ? SOUTH : NORTH;
+        if (RankOf(ep) != RelativeRank(st().sideToMove, RANK_6) ||
+            st().board[ep] != NO_PIECE || st().board[ep - push] != NO_PIECE ||
+            st().board[ep + push] != MakePiece(~st().sideToMove, PAWN)) {
+            return false;
+        }
+    }
+
+    // Castling rights need the king and rook on their initial squares
+    constexpr struct {
+        CastlingRights cr;
+        Piece king, rook;
+        Square kingSq, rookSq;
+    } CastlingChecks[] = {
+        { WHITE_OO, W_KING, W_ROOK, SQ_E1, SQ_H1 },
+        { WHITE_OOO, W_KING, W_ROOK, SQ_E1, SQ_A1 },
+        { BLACK_OO, B_KING, B_ROOK, SQ_E8, SQ_H8 },
+        { BLACK_OOO, B_KING, B_ROOK, SQ_E8, SQ_A8 },
+    };
+    for (const auto& check : CastlingChecks) {
+        if ((st().castlingRights & check.cr) &&
+            (st().board[check.kingSq] != check.king || st().board[check.rookSq] != check.rook)) {
+            return false;
+        }
+    }
+
+    // Exactly one king and at most 16 pieces per side, and the side that just moved can't be left
+    // in check
+    if (Count<KING>(WHITE) != 1 || Count<KING>(BLACK) != 1 || Popcount(Pieces(WHITE)) > 16 ||
+        Popcount(Pieces(BLACK)) > 16 ||
+        MoveGen::IsSquareAttacked(*this, square<KING>(~st().sideToMove), st().sideToMove)) {
+        return false;
+    }
+    return true;
+}
+
+std::string Position::Fen() const {
+    // 64 squares and 7 separators, then " w KQkq e3" and the two counters with their spaces
+    constexpr int CounterChars = 1 + std::numeric_limits<int>::digits10 + 2;
+    char buf[64 + 7 + 10 + 2 * CounterChars];
+    char* out = buf;
+
+    for (Rank rank = RANK_8; rank >= RANK_1; --rank) {
+        int empty = 0;
+        for (File file = FILE_A; file <= FILE_H; ++file) {
+            const Piece p = st().board[MakeSquare(file, rank)];
+            if (p == NO_PIECE) {
+                ++empty;
+                continue;
+            }
+            if (empty) {
+                *out++ = char('0' + empty);
+                empty = 0;
+            }
+            *out++ = PieceToChar[p];
+        }
+        if (empty) {
+            *out++ = char('0' + empty);
+        }
+        if (rank != RANK_1) {
+            *out++ = '/';
+        }
+    }
+
+    *out++ = ' ';
+    *out++ = (st().sideToMove == WHITE ? 'w' : 'b');
+    *out++ = ' ';
+
+    if (st().castlingRights == NO_CASTLING) {
+        *out++ = '-';
+    } else {
+        if (st().castlingRights & WHITE_OO) {
+            *out++ = 'K';
+        }
+        if (st().castlingRights & WHITE_OOO) {
+            *out++ = 'Q';
+        }
+        if (st().castlingRights & BLACK_OO) {
+            *out++ = 'k';
+        }
+        if (st().castlingRights & BLACK_OOO) {
+            *out++ = 'q';
+        }
+    }
+    *out++ = ' ';
+
+    if (st().epSquare == SQ_NONE) {
+        *out++ = '-';
+    } else {
+        *out++ = char('a' + FileOf(EpSuare()));
+        *out++ = char('1' + RankOf(EpSuare()));
+    }
+
+    const int fullMove = 1 + (st().gamePly - (st().sideToMove == BLACK)) / 2;
+    for (const int counter : { st().rule50, fullMove }) {
+        *out++ = ' ';
+        out = std::to_chars(out, buf + sizeof(buf), counter).ptr;
+    }
+
+    return std::string(buf, out);
+}
+
+PackedPosition Position::Pack() const {
+    PackedPosition packed{};
+
+    packed.occupied = Pieces();
+    int i = 0;
+    for (Bitboard b = Pieces(); b; ++i) {
+        packed.pieces[i / 2] |= uint8_t(st().board[PopLsb(b)] << (4 * (i & 1)));
+    }
+
+    packed.gamePly = uint16_t(st().gamePly);
+    packed.stmCastling = uint8_t((st().sideToMove << 4) | st().castlingRights);
+    packed.epSquare = uint8_t(st().epSquare);
+    packed.rule50 = uint8_t(std::min(st().rule50, 255));
+    return packed;
+}
+
+bool Position::Unpack(const PackedPosition& packed) {
+    reset();
+
+    if (Popcount(packed.occupied) > 32 || (packed.stmCastling >> 4) > BLACK) {
+        return false;
+    }
+
+    int i = 0;
+    for (Bitboard b = packed.occupied; b; ++i) {
+        const Square sq = PopLsb(b);
+        const Piece piece = Piece((packed.pieces[i / 2] >> (4 * (i & 1))) & 0xF);
+        if (TypeOf(piece) == ALL_PIECES || TypeOf(piece) > KING) {
+            return false;
+        }
+        putPiece(piece, sq);
+    }
+
+    st().sideToMove = Color(packed.stmCastling >> 4);
+    st().castlingRights = packed.stmCastling & 0xF;
+    st().epSquare = Square(packed.epSquare);
+    st().rule50 = packed.rule50;
+    st().gamePly = packed.gamePly;
+
+    if (st().epSquare != SQ_NONE && !IsOk(EpSuare())) {
+        return false;
+    }
+
+    // putPiece() already hashed the pieces
+    if (st().sideToMove == WHITE) {
+        st().posKey ^= side;
+    }
+    if (st().epSquare != SQ_NONE) {
+        st().posKey ^= psq[NO_PIECE][st().epSquare];
+    }
+    st().posKey ^= castling[st().castlingRights];
+
+    if (!isValid()) {
+        return false;
+    }
+    setCheckInfo();
+    return true;
 }
 
 bool Position::MakeMove(const Move& move) {
+    if (!leavesKingSafe(move)) {
+        Stats::Inc(Stats::ILLEGAL_MOVES);
+        return false;
+    }
+
     const Square from = move.FromSq();
     const Square to = move.ToSq();
 
+    assert(historyPly + 1 < MAX_PLIES);
+
+#ifndef NDEBUG
+    const bool givesCheck = GivesCheck(move);
+#endif
+
+#if defined(USE_COPY_MAKE)
+    // the child starts as a copy of its parent, which stays untouched for UnmakeMove()
+    std::memcpy(&states[historyPly + 1], &states[historyPly], offsetof(BoardState, checkInfo));
+    historyPly++;
+#else
     // save state
-    history[gamePly].posKey = posKey;
-    history[gamePly].rule50 = rule50;
-    history[gamePly].epSquare = epSquare;
-    history[gamePly].castlingRights = castlingRights;
-    history[gamePly].captured = board[to]; // normal captures only; en-passant handled separately
+    history[historyPly].posKey = st().posKey;
+    history[historyPly].rule50 = st().rule50;
+    history[historyPly].epSquare = st().epSquare;
+    history[historyPly].castlingRights = st().castlingRights;
+    // normal captures only; en-passant handled separately
+    history[historyPly].captured = st().board[to];
+#endif
 
     // remove old EP & castling from hash
-    if (epSquare != SQ_NONE) {
-        posKey ^= psq[NO_PIECE][epSquare];
+    if (st().epSquare != SQ_NONE) {
+        st().posKey ^= psq[NO_PIECE][st().epSquare];
     }
-    posKey ^= castling[castlingRights];
+    st().posKey ^= castling[st().castlingRights];
 
     // special move handling
     if (move.TypeOf() == EN_PASSANT) {
         // remove the captured pawn (behind 'to')
-        removePiece(to + (sideToMove == WHITE ? SOUTH : NORTH));
-        rule50 = 0; // reset 50-move on capture
+        removePiece(to + (st().sideToMove == WHITE ? SOUTH : NORTH));
+        st().rule50 = 0; // reset 50-move on capture
     } else if (move.TypeOf() == CASTLING) {
         switch (to) {
             case SQ_C1: movePiece(SQ_A1, SQ_D1); break;
@@ -234,12 +746,17 @@ bool Position::MakeMove(const Move& move) {
     }
 
     // normal capture handling (if a piece sits on 'to')
-    if (board[to] != NO_PIECE) {
+    if (st().board[to] != NO_PIECE) {
         removePiece(to);
-        rule50 = 0;
+        st().rule50 = 0;
     } else if (move.TypeOf() != EN_PASSANT) {
         // only increment rule50 if it wasn't a capture (en-passant already set to 0)
-        rule50++;
+        st().rule50++;
+    }
+
+    // pawn moves reset the 50-move counter as well
+    if (TypeOf(st().board[from]) == PAWN) {
+        st().rule50 = 0;
     }
 
     // move the piece
@@ -248,44 +765,56 @@ bool Position::MakeMove(const Move& move) {
     // promotion handling
     if (move.TypeOf() == PROMOTION) {
         removePiece(to);
-        putPiece(MakePiece(sideToMove, move.PromotionType()), to);
+        putPiece(MakePiece(st().sideToMove, move.PromotionType()), to);
     }
 
     // new en-passant target (from a double pawn push)
-    epSquare = SQ_NONE;
-    if (TypeOf(board[to]) == PAWN && std::abs(RankOf(from) - RankOf(to)) == 2) {
-        epSquare = from + (sideToMove == WHITE ? NORTH : SOUTH);
+    st().epSquare = SQ_NONE;
+    if (TypeOf(st().board[to]) == PAWN && std::abs(RankOf(from) - RankOf(to)) == 2) {
+        st().epSquare = from + (st().sideToMove == WHITE ? NORTH : SOUTH);
     }
-    if (epSquare != SQ_NONE) {
-        posKey ^= psq[NO_PIECE][epSquare]; // add new EP key
+    if (st().epSquare != SQ_NONE) {
+        st().posKey ^= psq[NO_PIECE][st().epSquare]; // add new EP key
     }
 
     // update castling rights and re-add castling key
-    castlingRights &= CastlePerm[from];
-    castlingRights &= CastlePerm[to];
-    posKey ^= castling[castlingRights];
+    st().castlingRights &= CastlePerm[from];
+    st().castlingRights &= CastlePerm[to];
+    st().posKey ^= castling[st().castlingRights];
 
     // flip side
-    sideToMove = ~sideToMove;
-    posKey ^= side;
+    st().sideToMove = ~st().sideToMove;
+    st().posKey ^= side;
 
-    gamePly++;
+    st().gamePly++;
+#if !defined(USE_COPY_MAKE)
+    historyPly++;
+#endif
 
-    if (MoveGen::IsSquareAttacked(*this, square<KING>(~sideToMove), sideToMove)) {
-        UnmakeMove(move);
-        return false;
-    }
+    setCheckInfo();
+    assert(!MoveGen::IsSquareAttacked(*this, square<KING>(~st().sideToMove), st().sideToMove));
+    assert(givesCheck == (Checkers() != 0));
     return true;
 }
 
+#if defined(USE_COPY_MAKE)
+
+void Position::UnmakeMove(const Move&) {
+    // the parent is still intact one ply down
+    historyPly--;
+}
+
+#else
+
 void Position::UnmakeMove(const Move& move) {
-    gamePly--;
+    st().gamePly--;
+    historyPly--;
 
     const Square from = move.FromSq();
     const Square to = move.ToSq();
 
     if (move.TypeOf() == EN_PASSANT) {
-        putPiece(MakePiece(sideToMove, PAWN), to + PawnPush(sideToMove));
+        putPiece(MakePiece(st().sideToMove, PAWN), to + PawnPush(st().sideToMove));
     } else if (move.TypeOf() == CASTLING) {
         switch (to) {
             case SQ_C1: movePiece(SQ_D1, SQ_A1); break;
@@ -296,25 +825,27 @@ void Position::UnmakeMove(const Move& move) {
         }
     }
 
-    sideToMove = ~sideToMove;
+    st().sideToMove = ~st().sideToMove;
 
     movePiece(to, from);
 
     if (move.TypeOf() == PROMOTION) {
         removePiece(from);
-        putPiece(MakePiece(sideToMove, PAWN), from);
+        putPiece(MakePiece(st().sideToMove, PAWN), from);
     }
 
-    if (history[gamePly].captured != NO_PIECE) {
-        putPiece(history[gamePly].captured, to);
+    if (history[historyPly].captured != NO_PIECE) {
+        putPiece(history[historyPly].captured, to);
     }
 
-    epSquare = history[gamePly].epSquare;
-    rule50 = history[gamePly].rule50;
-    castlingRights = history[gamePly].castlingRights;
-    posKey = history[gamePly].posKey;
+    st().epSquare = history[historyPly].epSquare;
+    st().rule50 = history[historyPly].rule50;
+    st().castlingRights = history[historyPly].castlingRights;
+    st().posKey = history[historyPly].posKey;
 }
 
+#endif
+
 void Position::Print() const {
     using std::cout;
 
@@ -322,7 +853,7 @@ void Position::Print() const {
     for (Rank rank = RANK_8; rank >= RANK_1; --rank) {
         for (File file = FILE_A; file <= FILE_H; ++file) { // <= not <
             Square sq = MakeSquare(file, rank);
-            Piece p = board[sq];
+            Piece p = st().board[sq];
             char c = (p != NO_PIECE ? PieceToChar[p] : ' ');
             cout << "| " << c << " ";
         }
@@ -331,18 +862,18 @@ void Position::Print() const {
     }
 
     cout << "  a   b   c   d   e   f   g   h\n";
-    cout << "Side to move: " << (sideToMove == WHITE ? "w" : "b") << "\n";
+    cout << "Side to move: " << (st().sideToMove == WHITE ? "w" : "b") << "\n";
     cout << "En passant square: ";
-    if (IsOk(epSquare)) {
-        cout << epSquare;
+    if (IsOk(EpSuare())) {
+        cout << EpSuare();
     } else {
         cout << "none";
     }
     cout << "\n";
-    cout << "Castle permissions: " << (castlingRights & WHITE_OO ? "K" : "-")
-         << (castlingRights & WHITE_OOO ? "Q" : "-") << (castlingRights & BLACK_OO ? "k" : "-")
-         << (castlingRights & BLACK_OOO ? "q" : "-") << "\n";
-    cout << "Position key: " << std::hex << posKey << std::dec << "\n";
+    cout << "Castle permissions: " << (CanCastle(WHITE_OO) ? "K" : "-")
+         << (CanCastle(WHITE_OOO) ? "Q" : "-") << (CanCastle(BLACK_OO) ? "k" : "-")
+         << (CanCastle(BLACK_OOO) ? "q" : "-") << "\n";
+    cout << "Position key: " << std::hex << st().posKey << std::dec << "\n";
 }
 
 void Position::perft(int depth) {
@@ -353,6 +884,14 @@ void Position::perft(int depth) {
     MoveList list;
     MoveGen::GeneratePseudo(*this, list);
 
+    // The legality test doesn't need the move to be made, so the last ply only counts
+    if (depth == 1) {
+        for (const auto& move : list) {
+            perftLealNodes += leavesKingSafe(move);
+        }
+        return;
+    }
+
     for (const auto& move : list) {
         if (!MakeMove(move)) {
             continue;
@@ -362,6 +901,12 @@ void Position::perft(int depth) {
     }
 }
 
+uint64_t Position::Perft(int depth) {
+    perftLealNodes = 0;
+    perft(depth);
+    return perftLealNodes;
+}
+
 uint64_t Position::PerftTest(int depth) {
     using namespace std::chrono;
 
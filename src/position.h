@@ -1,23 +1,102 @@
 #pragma once
 
 #include "bitboard.h"
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace Zugzwang {
 
+constexpr const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Make/unmake updates one board in place and reverses each move from its StateInfo. Copy-make,
+// chosen with the ZUGZWANG_COPY_MAKE CMake option, copies the board into the next ply before
+// the move and unmakes by dropping back to the previous copy.
+#if defined(USE_COPY_MAKE)
+constexpr const char* MakeMoveMode = "copy-make";
+#else
+constexpr const char* MakeMoveMode = "make/unmake";
+#endif
+
+// Computed once per move for the position it reaches and kept with that ply, so that
+// UnmakeMove() gets it back just by stepping to the previous ply
+struct CheckInfo {
+    Bitboard checkers;                    // enemy pieces giving check
+    Bitboard blockersForKing[COLOR_NB];   // sole pieces between a king and an enemy slider
+    Bitboard pinners[COLOR_NB];           // sliders pinning a piece to the other king
+    Bitboard checkSquares[PIECE_TYPE_NB]; // squares where each piece type checks the enemy
+};
+
+// Everything a move changes. Copy-make copies it whole, so it stays trivially copyable. The
+// bitboards come first, then the key and the one-byte fields, so that the first two cache lines
+// hold all a move generator or MakeMove() reads besides the mailbox.
+struct alignas(64) BoardState {
+    Bitboard byColorBB[COLOR_NB];
+    Bitboard byTypeBB[PIECE_TYPE_NB];
+    Key posKey;
+    int rule50;
+    int gamePly;
+    Color sideToMove;
+    uint8_t epSquare; // a Square, SQ_NONE if there is none
+    uint8_t castlingRights;
+    uint8_t pieceNb[PIECE_NB];
+    Piece board[SQUARE_NB];
+
+#if defined(USE_COPY_MAKE)
+    CheckInfo checkInfo; // last, MakeMove() recomputes it instead of copying it
+#endif
+};
+
+static_assert(std::is_trivially_copyable_v<BoardState>);
+static_assert(offsetof(BoardState, pieceNb) <= 128);
+#if defined(USE_COPY_MAKE)
+static_assert(sizeof(BoardState) == 320);
+#else
+static_assert(sizeof(BoardState) == 192);
+
+// What UnmakeMove() needs to reverse a move. The check info of each ply is kept apart, so that
+// IsRepetition() walks four of these per cache line.
 struct StateInfo {
-    Square epSquare;
+    Key posKey;
     int rule50;
-    int castlingRights;
+    uint8_t epSquare;
+    uint8_t castlingRights;
     Piece captured;
-    Key posKey;
 };
 
+static_assert(sizeof(StateInfo) == 16);
+#endif
+
+// Fixed-size 32-byte position encoding for datasets, written in host byte order
+struct PackedPosition {
+    Bitboard occupied;   // every occupied square
+    uint8_t pieces[16];  // 4-bit Piece codes of the occupied squares from a1 up, low nibble first
+    uint16_t gamePly;    // ply count from the start of the game
+    uint8_t stmCastling; // side to move in bit 4, castling rights in bits 0-3
+    uint8_t epSquare;    // SQ_NONE if there is no en passant square
+    uint8_t rule50;      // halfmove clock, saturated at 255
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+
 class Position {
   public:
-    Position();
-
-    void ParseFen(const std::string& fen);
+    // Initializes the Zobrist keys shared by all positions, must be called once at startup. The
+    // keys come from a fixed seed, so every process of a build hashes positions alike.
+    static void Init();
+    // All the Zobrist keys folded into one, for data shared between processes to be checked with
+    static Key KeySignature();
+
+    // Validates while parsing and never allocates. On failure the position is left unusable and
+    // false is returned.
+    bool ParseFen(std::string_view fen);
+    std::string Fen() const;
+
+    PackedPosition Pack() const;
+    // Returns false, leaving the position unusable, if the encoding is malformed or describes a
+    // position that ParseFen() would refuse
+    bool Unpack(const PackedPosition& packed);
 
     bool MakeMove(const Move& move);
     void UnmakeMove(const Move& move);
@@ -25,13 +104,15 @@ class Position {
     void Print() const;
 
     uint64_t PerftTest(int depth);
+    // Quiet variant of PerftTest, returns the number of leaf nodes
+    uint64_t Perft(int depth);
 
-    Bitboard Pieces() const { return byTypeBB[ALL_PIECES]; }
-    Bitboard Pieces(Color c) const { return byColorBB[c]; }
+    Bitboard Pieces() const { return st().byTypeBB[ALL_PIECES]; }
+    Bitboard Pieces(Color c) const { return st().byColorBB[c]; }
 
     template <typename... PieceTypes>
     Bitboard Pieces(PieceTypes... pts) const {
-        return (byTypeBB[pts] | ...);
+        return (st().byTypeBB[pts] | ...);
     }
 
     template <typename... PieceTypes>
@@ -41,7 +122,7 @@ class Position {
 
     template <PieceType Pt>
     int Count(Color c) const {
-        return pieceNb[MakePiece(c, Pt)];
+        return st().pieceNb[MakePiece(c, Pt)];
     }
 
     template <PieceType Pt>
@@ -57,38 +138,71 @@ class Position {
 
     Piece PieceOn(Square sq) const {
         assert(IsOk(sq));
-        return board[sq];
+        return st().board[sq];
     }
 
-    Color SideToMove() const { return sideToMove; }
-    Square EpSuare() const { return epSquare; }
-    bool CanCastle(CastlingRights cr) const { return castlingRights & cr; }
+    Color SideToMove() const { return st().sideToMove; }
+    Square EpSuare() const { return Square(st().epSquare); }
+    bool CanCastle(CastlingRights cr) const { return st().castlingRights & cr; }
+    int Rule50() const { return st().rule50; }
+    int GamePly() const { return st().gamePly; }
+    Key PosKey() const { return st().posKey; }
+
+    // Whether the position occurred before since the last capture or pawn move, within the
+    // moves made on this Position
+    bool IsRepetition() const;
+
+    Bitboard AttackersTo(Square sq, Bitboard occupied) const;
+
+    Bitboard Checkers() const { return checkInfo().checkers; }
+    Bitboard BlockersForKing(Color c) const { return checkInfo().blockersForKing[c]; }
+    Bitboard Pinners(Color c) const { return checkInfo().pinners[c]; }
+    Bitboard CheckSquares(PieceType pt) const { return checkInfo().checkSquares[pt]; }
+    // Whether a pseudo-legal move of the side to move checks the enemy king
+    bool GivesCheck(const Move& move) const;
+
+    // Whether any 16-bit move, such as one from a table, is among those MoveGen::GeneratePseudo()
+    // gives here. Checks the move itself without generating any.
+    bool IsPseudoLegal(const Move& move) const;
+    // Whether MakeMove() would accept the move, for any 16-bit move
+    bool IsLegal(const Move& move) const;
 
   private:
+#if defined(USE_COPY_MAKE)
+    BoardState& st() { return states[historyPly]; }
+    const BoardState& st() const { return states[historyPly]; }
+    CheckInfo& checkInfo() { return states[historyPly].checkInfo; }
+    const CheckInfo& checkInfo() const { return states[historyPly].checkInfo; }
+#else
+    BoardState& st() { return state; }
+    const BoardState& st() const { return state; }
+    CheckInfo& checkInfo() { return checkInfos[historyPly]; }
+    const CheckInfo& checkInfo() const { return checkInfos[historyPly]; }
+#endif
+
     void putPiece(Piece piece, Square sq);
     void removePiece(Square sq);
     void movePiece(Square from, Square to);
 
     void generatePosKey();
+    void setCheckInfo();
+    Bitboard sliderBlockers(Bitboard sliders, Square sq, Bitboard& pinners) const;
+    bool leavesKingSafe(const Move& move) const; // for a pseudo-legal move
     void reset();
     void updateListsBitboards();
+    bool isValid() const;
     void perft(int depth);
 
-    Piece board[SQUARE_NB];
-    int pieceNb[PIECE_NB];
-    Color sideToMove;
-    Bitboard byColorBB[COLOR_NB];
-    Bitboard byTypeBB[PIECE_TYPE_NB];
-
-    Square epSquare;
-    int rule50;
-    int gamePly;
-    int castlingRights;
-    Key posKey;
-
+    int historyPly; // moves made since the position was set up, indexes the ply arrays
     uint64_t perftLealNodes;
 
+#if defined(USE_COPY_MAKE)
+    BoardState states[MAX_PLIES]; // the current board and, below it, those of its ancestors
+#else
+    BoardState state;
     StateInfo history[MAX_PLIES];
+    CheckInfo checkInfos[MAX_PLIES];
+#endif
 };
 
 } // namespace Zugzwang
@@ -0,0 +1,598 @@
+#include "pch.h"
+#include "search.h"
+#include "attacks.h"
+#include "eval.h"
+#include "movegen.h"
+#include "position.h"
+#include "stats.h"
+#include "tt.h"
+#include "uci.h"
+#include <algorithm>
+
+namespace Zugzwang {
+
+namespace Search {
+
+namespace {
+
+using namespace std::chrono;
+
+constexpr int64_t MoveOverhead = 10; // ms kept back for the GUI and the operating system
+
+// Move ordering bands, a move's score within its band orders it further
+constexpr int TTMoveScore = 1 << 30;
+constexpr int CaptureScore = 1 << 28;
+constexpr int KillerScore = 1 << 27;
+
+int64_t elapsedMs(steady_clock::time_point start) {
+    return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+bool isCapture(const Position& pos, Move move) {
+    return pos.PieceOn(move.ToSq()) != NO_PIECE || move.TypeOf() == EN_PASSANT;
+}
+
+// Picks the best scored move of list[i..] and swaps it into place i
+Move pickNext(MoveList& list, int* scores, int i) {
+    int best = i;
+    for (int j = i + 1; j < list.Size(); ++j) {
+        if (scores[j] > scores[best]) {
+            best = j;
+        }
+    }
+    std::swap(list[i], list[best]);
+    std::swap(scores[i], scores[best]);
+    return list[i];
+}
+
+} // namespace
+
+void Worker::Clear() {
+    std::memset(killers, 0, sizeof(killers));
+    std::memset(history, 0, sizeof(history));
+}
+
+const std::vector<RootMove>& Worker::Run(Position& pos, const Limits& searchLimits, int multiPV,
+                                         std::ostream* os) {
+    limits = searchLimits;
+    startTime = steady_clock::now();
+    clockStart.store(startTime.time_since_epoch().count(), std::memory_order_relaxed);
+    stopped = false;
+    nodes = 0;
+    completedDepth = 0;
+    evalCache.ResetCounters();
+
+    // Plan for a fixed share of the remaining time, and never use more than a fifth of it
+    const Color us = pos.SideToMove();
+    optimumTime = maximumTime = 0;
+    if (limits.movetime) {
+        optimumTime = maximumTime = std::max<int64_t>(limits.movetime - MoveOverhead, 1);
+    } else if (limits.time[us]) {
+        const int64_t remaining = std::max<int64_t>(limits.time[us] - MoveOverhead, 1);
+        const int movesLeft = limits.movestogo ? std::min(limits.movestogo, 40) : 40;
+        optimumTime = remaining / movesLeft + limits.inc[us] * 3 / 4;
+        maximumTime = std::min(optimumTime * 3, remaining / 5 + limits.inc[us]);
+        optimumTime = std::min(optimumTime, maximumTime);
+    }
+
+    tt.NewSearch();
+
+    rootMoves.clear();
+    MoveList list;
+    MoveGen::GeneratePseudo(pos, list);
+    for (const auto move : list) {
+        if (pos.MakeMove(move)) {
+            pos.UnmakeMove(move);
+            rootMoves.emplace_back(move);
+        }
+    }
+
+    if (rootMoves.empty()) {
+        if (os) {
+            *os << "info depth 0 score " << (pos.Checkers() ? "mate 0" : "cp 0") << std::endl;
+        }
+        waitToReport();
+        return rootMoves;
+    }
+
+    multiPV = std::clamp(multiPV, 1, int(rootMoves.size()));
+    const int maxDepth = limits.depth ? std::min(limits.depth, MAX_SEARCH_PLY - 1)
+                                      : MAX_SEARCH_PLY - 1;
+
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        for (auto& rm : rootMoves) {
+            rm.previousScore = rm.score;
+        }
+
+        // Each line searches the moves not already chosen for the lines above it
+        for (int pvIdx = 0; pvIdx < multiPV && !stopped; ++pvIdx) {
+            selDepth = 0;
+
+            const int previous = rootMoves[pvIdx].previousScore;
+            int delta = 25;
+            int alpha = -VALUE_INFINITE;
+            int beta = VALUE_INFINITE;
+            if (depth >= 4 && std::abs(previous) < VALUE_MATE_IN_MAX_PLY) {
+                alpha = std::max(previous - delta, -VALUE_INFINITE);
+                beta = std::min(previous + delta, VALUE_INFINITE);
+            }
+
+            // Aspiration window, widened until the score falls inside it
+            while (true) {
+                const int score = searchRoot(pos, depth, alpha, beta, pvIdx);
+                std::stable_sort(rootMoves.begin() + pvIdx, rootMoves.end(),
+                                 [](const RootMove& a, const RootMove& b) {
+                                     return a.score > b.score;
+                                 });
+                if (stopped) {
+                    break;
+                }
+
+                if (score <= alpha) {
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(score - delta, -VALUE_INFINITE);
+                } else if (score >= beta) {
+                    beta = std::min(score + delta, VALUE_INFINITE);
+                } else {
+                    break;
+                }
+                delta += delta / 2;
+            }
+
+            std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIdx + 1,
+                             [](const RootMove& a, const RootMove& b) {
+                                 return a.score > b.score;
+                             });
+        }
+
+        if (stopped) {
+            break;
+        }
+
+        completedDepth = depth;
+        if (os) {
+            printInfo(*os, depth, multiPV);
+        }
+
+        // A mate found within the depth searched cannot get any shorter
+        if (multiPV == 1 && !limits.infinite &&
+            VALUE_MATE - std::abs(rootMoves[0].score) <= depth) {
+            break;
+        }
+
+        if (outOfTime(optimumTime)) {
+            break;
+        }
+    }
+
+    if (os) {
+        const uint64_t probes = evalCache.Probes();
+        *os << "info string Eval cache hit rate: " << evalCache.Hits() << "/" << probes << " ("
+            << evalCache.Hits() * 100 / std::max<uint64_t>(probes, 1) << "%)" << std::endl;
+    }
+
+    waitToReport();
+    return rootMoves;
+}
+
+// A finished ponder search waits for the opponent's move, and an infinite one for "stop", before
+// it may report
+void Worker::waitToReport() {
+    std::unique_lock lock(ponderMutex);
+    ponderEnded.wait(lock, [this] {
+        return (!pondering.load(std::memory_order_relaxed) && !limits.infinite) ||
+               stopRequested.load(std::memory_order_relaxed);
+    });
+    pondering.store(false, std::memory_order_relaxed);
+    stopRequested.store(false, std::memory_order_relaxed);
+}
+
+void Worker::Prepare(bool ponder) {
+    std::lock_guard lock(ponderMutex);
+    stopRequested.store(false, std::memory_order_relaxed);
+    pondering.store(ponder, std::memory_order_relaxed);
+}
+
+void Worker::PonderHit() {
+    {
+        std::lock_guard lock(ponderMutex);
+        clockStart.store(steady_clock::now().time_since_epoch().count(),
+                         std::memory_order_relaxed);
+        pondering.store(false, std::memory_order_relaxed);
+    }
+    ponderEnded.notify_one();
+}
+
+void Worker::Stop() {
+    {
+        std::lock_guard lock(ponderMutex);
+        stopRequested.store(true, std::memory_order_relaxed);
+    }
+    ponderEnded.notify_one();
+}
+
+int Worker::searchRoot(Position& pos, int depth, int alpha, int beta, int pvIdx) {
+    int bestScore = -VALUE_INFINITE;
+
+    for (size_t i = pvIdx; i < rootMoves.size(); ++i) {
+        RootMove& rm = rootMoves[i];
+        const Move move = rm.pv[0];
+
+        pos.MakeMove(move);
+        const int newDepth = depth - 1 + (pos.Checkers() ? 1 : 0);
+
+        int score;
+        if (i == size_t(pvIdx)) {
+            score = -search(pos, newDepth, 1, -beta, -alpha, true);
+        } else {
+            score = -search(pos, newDepth, 1, -alpha - 1, -alpha, false);
+            if (score > alpha && score < beta) {
+                score = -search(pos, newDepth, 1, -beta, -alpha, true);
+            }
+        }
+        pos.UnmakeMove(move);
+
+        if (stopped) {
+            return bestScore;
+        }
+
+        if (i == size_t(pvIdx) || score > alpha) {
+            rm.score = score;
+            rm.selDepth = selDepth;
+            rm.pv.assign(1, move);
+            rm.pv.insert(rm.pv.end(), &pvTable[1][1], &pvTable[1][pvLength[1]]);
+        } else {
+            rm.score = -VALUE_INFINITE;
+        }
+
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return bestScore;
+}
+
+int Worker::search(Position& pos, int depth, int ply, int alpha, int beta, bool pvNode) {
+    if (depth <= 0) {
+        return qsearch(pos, alpha, beta, ply, 0);
+    }
+
+    pvLength[ply] = ply;
+    if (checkLimits()) {
+        return 0;
+    }
+    selDepth = std::max(selDepth, ply);
+
+    if (pos.Rule50() >= 100 || pos.IsRepetition()) {
+        return VALUE_DRAW;
+    }
+
+    const bool inCheck = pos.Checkers();
+    if (ply >= MAX_SEARCH_PLY - 1) {
+        return inCheck ? VALUE_DRAW : Eval::Evaluate(pos);
+    }
+
+    // Mate distance pruning: no line from here can beat a shorter mate already found
+    alpha = std::max(alpha, -VALUE_MATE + ply);
+    beta = std::min(beta, VALUE_MATE - ply - 1);
+    if (alpha >= beta) {
+        return alpha;
+    }
+
+    const Key key = pos.PosKey();
+    bool found;
+    TTEntry* const entry = tt.Probe(key, found);
+    const Move ttMove = found ? entry->GetMove() : Move::None();
+
+    if (found && !pvNode && entry->Depth() >= depth) {
+        const int score = ScoreFromTT(entry->Score(), ply);
+        const Bound bound = entry->GetBound();
+        if ((bound & BOUND_LOWER && score >= beta) || (bound & BOUND_UPPER && score <= alpha)) {
+            return score;
+        }
+    }
+
+    // Out of check the attacks are computed at most once, for the evaluation and the move
+    // generator
+    AttackInfo ai;
+    bool aiReady = false;
+
+    // Reverse futility pruning: far enough above beta that a shallow search will not come back
+    if (!pvNode && !inCheck && depth <= 6 && std::abs(beta) < VALUE_MATE_IN_MAX_PLY) {
+        const int eval = evaluate(pos, ai, aiReady);
+        if (eval - 100 * depth >= beta) {
+            return eval;
+        }
+    }
+
+    MoveList list;
+    if (inCheck) {
+        MoveGen::Generate<MoveGen::EVASIONS>(pos, list);
+    } else {
+        if (!aiReady) {
+            ai.Compute(pos);
+        }
+        MoveGen::Generate<MoveGen::ALL_MOVES>(pos, ai, list);
+    }
+    int scores[MAX_MOVES];
+    scoreMoves(pos, list, scores, ttMove, ply);
+
+    const int originalAlpha = alpha;
+    int bestScore = -VALUE_INFINITE;
+    Move bestMove = Move::None();
+    int legalMoves = 0;
+
+    for (int i = 0; i < list.Size(); ++i) {
+        const Move move = pickNext(list, scores, i);
+        const bool quiet = !isCapture(pos, move) && move.TypeOf() != PROMOTION;
+
+        if (!pos.MakeMove(move)) {
+            continue;
+        }
+        ++legalMoves;
+
+        const bool givesCheck = pos.Checkers();
+        const int newDepth = depth - 1 + (givesCheck ? 1 : 0);
+
+        int score;
+        if (legalMoves == 1) {
+            score = -search(pos, newDepth, ply + 1, -beta, -alpha, pvNode);
+        } else {
+            // Late move reductions for quiet moves that ordering put towards the end
+            int reduction = 0;
+            if (depth >= 3 && legalMoves > 3 && quiet && !inCheck && !givesCheck) {
+                reduction = std::min(1 + (legalMoves > 8) + (depth > 6), newDepth - 1);
+            }
+
+            score = -search(pos, newDepth - reduction, ply + 1, -alpha - 1, -alpha, false);
+            if (score > alpha && reduction) {
+                score = -search(pos, newDepth, ply + 1, -alpha - 1, -alpha, false);
+            }
+            if (score > alpha && score < beta && pvNode) {
+                score = -search(pos, newDepth, ply + 1, -beta, -alpha, true);
+            }
+        }
+        pos.UnmakeMove(move);
+
+        if (stopped) {
+            return 0;
+        }
+
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                bestMove = move;
+                if (pvNode) {
+                    updatePv(ply, move);
+                }
+                if (alpha >= beta) {
+                    Stats::IncCutoff(legalMoves);
+                    if (quiet) {
+                        if (killers[ply][0] != move) {
+                            killers[ply][1] = killers[ply][0];
+                            killers[ply][0] = move;
+                        }
+                        int& h = history[pos.SideToMove()][move.FromSq()][move.ToSq()];
+                        h = std::min(h + depth * depth, 1 << 20);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!legalMoves) {
+        return inCheck ? -VALUE_MATE + ply : VALUE_DRAW;
+    }
+
+    const Bound bound = bestScore >= beta           ? BOUND_LOWER
+                      : alpha > originalAlpha ? BOUND_EXACT
+                                              : BOUND_UPPER;
+    entry->Save(key, ScoreToTT(bestScore, ply), bound, depth, bestMove, tt.Generation());
+    return bestScore;
+}
+
+// Resolves captures until the position is quiet, with the quiet checks of the first ply and
+// every evasion when in check so that mates at the horizon are not missed
+int Worker::qsearch(Position& pos, int alpha, int beta, int ply, int qply) {
+    pvLength[ply] = ply;
+    if (checkLimits()) {
+        return 0;
+    }
+    selDepth = std::max(selDepth, ply);
+
+    const bool inCheck = pos.Checkers();
+    if (ply >= MAX_SEARCH_PLY - 1) {
+        return inCheck ? VALUE_DRAW : Eval::Evaluate(pos);
+    }
+
+    const Key key = pos.PosKey();
+    bool found;
+    TTEntry* const entry = tt.Probe(key, found);
+    if (found) {
+        const int score = ScoreFromTT(entry->Score(), ply);
+        const Bound bound = entry->GetBound();
+        if ((bound & BOUND_LOWER && score >= beta) || (bound & BOUND_UPPER && score <= alpha)) {
+            return score;
+        }
+    }
+
+    int bestScore = -VALUE_INFINITE;
+    MoveList list;
+    if (inCheck) {
+        MoveGen::Generate<MoveGen::EVASIONS>(pos, list);
+    } else {
+        AttackInfo ai;
+        bool aiReady = false;
+
+        bestScore = evaluate(pos, ai, aiReady); // standing pat
+        if (bestScore >= beta) {
+            return bestScore;
+        }
+        alpha = std::max(alpha, bestScore);
+
+        if (!aiReady) {
+            ai.Compute(pos);
+        }
+
+        MoveGen::Generate<MoveGen::CAPTURES>(pos, ai, list);
+        if (qply == 0) {
+            MoveGen::Generate<MoveGen::QUIET_CHECKS>(pos, ai, list);
+        }
+    }
+    int scores[MAX_MOVES];
+    scoreMoves(pos, list, scores, found ? entry->GetMove() : Move::None(), ply);
+
+    const int originalAlpha = alpha;
+    Move bestMove = Move::None();
+    int legalMoves = 0;
+
+    for (int i = 0; i < list.Size(); ++i) {
+        const Move move = pickNext(list, scores, i);
+        if (!pos.MakeMove(move)) {
+            continue;
+        }
+        ++legalMoves;
+
+        const int score = -qsearch(pos, -beta, -alpha, ply + 1, qply + 1);
+        pos.UnmakeMove(move);
+
+        if (stopped) {
+            return 0;
+        }
+
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                bestMove = move;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (inCheck && !legalMoves) {
+        return -VALUE_MATE + ply;
+    }
+
+    const Bound bound = bestScore >= beta           ? BOUND_LOWER
+                      : alpha > originalAlpha ? BOUND_EXACT
+                                              : BOUND_UPPER;
+    entry->Save(key, ScoreToTT(bestScore, ply), bound, 0, bestMove, tt.Generation());
+    return bestScore;
+}
+
+// The static evaluation of pos, which is not in check, from the eval cache when it is there.
+// Otherwise ai is computed for the evaluation, and aiReady set so the caller can reuse it.
+int Worker::evaluate(const Position& pos, AttackInfo& ai, bool& aiReady) {
+    int eval;
+    if (evalCache.Probe(pos.PosKey(), eval)) {
+        return eval;
+    }
+
+    ai.Compute(pos);
+    aiReady = true;
+    eval = Eval::Evaluate(pos, ai);
+    evalCache.Store(pos.PosKey(), eval);
+    return eval;
+}
+
+// TT move first, then captures by most valuable victim and least valuable attacker, then the
+// killers and the other quiet moves by history
+void Worker::scoreMoves(const Position& pos, const MoveList& list, int* scores, Move ttMove,
+                        int ply) const {
+    const Color us = pos.SideToMove();
+
+    int i = 0;
+    for (const auto move : list) {
+        int& score = scores[i++];
+
+        if (move == ttMove) {
+            score = TTMoveScore;
+        } else if (isCapture(pos, move) || (move.TypeOf() == PROMOTION &&
+                                             move.PromotionType() == QUEEN)) {
+            const Piece victim = pos.PieceOn(move.ToSq());
+            score = CaptureScore + 8 * (victim ? Eval::PieceValue[TypeOf(victim)] : 100) -
+                    Eval::PieceValue[TypeOf(pos.PieceOn(move.FromSq()))] / 100;
+            if (move.TypeOf() == PROMOTION) {
+                score += Eval::PieceValue[QUEEN];
+            }
+        } else if (move == killers[ply][0]) {
+            score = KillerScore + 1;
+        } else if (move == killers[ply][1]) {
+            score = KillerScore;
+        } else if (move.TypeOf() == PROMOTION) {
+            score = -1; // underpromotions last
+        } else {
+            score = history[us][move.FromSq()][move.ToSq()];
+        }
+    }
+}
+
+void Worker::updatePv(int ply, Move move) {
+    pvTable[ply][ply] = move;
+    for (int i = ply + 1; i < pvLength[ply + 1]; ++i) {
+        pvTable[ply][i] = pvTable[ply + 1][i];
+    }
+    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+}
+
+// Counts the node and, every 1024 nodes, checks the time and node limits and the stop request
+bool Worker::checkLimits() {
+    if (stopped) {
+        return true;
+    }
+    if (++nodes & 1023) {
+        return false;
+    }
+
+    if (stopRequested.load(std::memory_order_relaxed) ||
+        (limits.nodes && nodes >= limits.nodes)) {
+        stopped = true;
+    } else if (completedDepth) {
+        stopped = outOfTime(maximumTime);
+    }
+    return stopped;
+}
+
+// Whether a time budget is used up, counted from the ponder hit when there was one
+bool Worker::outOfTime(int64_t budget) const {
+    if (!budget || limits.infinite || pondering.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    const steady_clock::time_point start(
+        steady_clock::duration(clockStart.load(std::memory_order_relaxed)));
+    return elapsedMs(start) >= budget;
+}
+
+void Worker::printInfo(std::ostream& os, int depth, int multiPV) const {
+    const uint64_t ms = elapsedMs(startTime);
+
+    for (int i = 0; i < multiPV; ++i) {
+        const RootMove& rm = rootMoves[i];
+
+        os << "info depth " << depth << " seldepth " << rm.selDepth << " multipv " << i + 1
+           << " score " << UCI::FormatScore(rm.score) << " nodes " << nodes << " nps "
+           << nodes * 1000 / std::max<uint64_t>(ms, 1) << " hashfull " << tt.Hashfull()
+           << " time " << ms << " pv";
+        for (const auto move : rm.pv) {
+            os << ' ' << UCI::FormatMove(move);
+        }
+        os << '\n';
+    }
+    os << std::flush;
+}
+
+} // namespace Search
+
+} // namespace Zugzwang
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "tt.h"
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace Zugzwang {
+
+class Position;
+struct AttackInfo;
+
+namespace Search {
+
+// What "go" asked for; zero means no limit of that kind
+struct Limits {
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t movetime = 0; // ms
+    int64_t time[COLOR_NB] = {};
+    int64_t inc[COLOR_NB] = {};
+    int movestogo = 0;
+    bool infinite = false;
+    int mate = 0; // moves, looked for by the mate finder instead of a normal search
+};
+
+struct RootMove {
+    explicit RootMove(Move m) : pv(1, m) {}
+
+    int score = -VALUE_INFINITE;         // of the last search of this move, -VALUE_INFINITE if
+                                         // it only proved the move worse than the line above
+    int previousScore = -VALUE_INFINITE; // as of the previous iteration, centres the window
+    int selDepth = 0;
+    std::vector<Move> pv; // starts with the move itself
+};
+
+// Iterative deepening alpha-beta with a quiescence search. One Worker searches one position at
+// a time; its move ordering history carries over between searches until Clear().
+class Worker {
+  public:
+    explicit Worker(TranspositionTable& table) : tt(table) {
+        evalCache.Resize(EvalCache::DefaultSizeMB);
+    }
+
+    // Searches pos, which is left as it was, until the limits are reached or Stop() is called.
+    // The best multiPV root moves are searched as separate lines within every iteration, each
+    // with the lines above it excluded. Prints "info" lines to os unless it is nullptr and
+    // returns the root moves, best first; there are none if pos is mate or stalemate.
+    const std::vector<RootMove>& Run(Position& pos, const Limits& limits, int multiPV,
+                                     std::ostream* os);
+
+    // Drops a Stop() that came after the last search ended and sets whether the next Run() is a
+    // ponder search, which ignores the clock and, when it is done, holds its result back until
+    // PonderHit() or Stop(); an infinite search holds its result back until Stop(). Call it
+    // before Run() is started on another thread, so that an early Stop() or PonderHit() is not
+    // lost.
+    void Prepare(bool ponder);
+
+    // Turns a ponder search into a normal one, its clock starting now. Safe to call from another
+    // thread, like Stop(); both also apply to a Run() that has not started yet.
+    void PonderHit();
+    void Stop();
+
+    // Forgets the killer and history tables, for a new game
+    void Clear();
+
+    // In MB, zero turns the cache off. Its hit rate is counted per Run().
+    void ResizeEvalCache(size_t mb) { evalCache.Resize(mb); }
+    const EvalCache& GetEvalCache() const { return evalCache; }
+
+    uint64_t Nodes() const { return nodes; }
+    int CompletedDepth() const { return completedDepth; }
+
+  private:
+    int searchRoot(Position& pos, int depth, int alpha, int beta, int pvIdx);
+    int search(Position& pos, int depth, int ply, int alpha, int beta, bool pvNode);
+    int qsearch(Position& pos, int alpha, int beta, int ply, int qply);
+    int evaluate(const Position& pos, AttackInfo& ai, bool& aiReady);
+
+    void scoreMoves(const Position& pos, const MoveList& list, int* scores, Move ttMove,
+                    int ply) const;
+    void updatePv(int ply, Move move);
+    bool checkLimits();
+    void waitToReport();
+    bool outOfTime(int64_t budget) const;
+    void printInfo(std::ostream& os, int depth, int multiPV) const;
+
+    TranspositionTable& tt;
+    EvalCache evalCache;
+    Limits limits;
+    std::vector<RootMove> rootMoves;
+
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<std::chrono::steady_clock::rep> clockStart{ 0 }; // moved to the ponder hit
+    int64_t optimumTime = 0; // ms, no new iteration is started after it
+    int64_t maximumTime = 0; // ms, the search stops when it is reached
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<bool> pondering{ false };
+    std::mutex ponderMutex;
+    std::condition_variable ponderEnded;
+    bool stopped = false;
+
+    uint64_t nodes = 0;
+    int selDepth = 0;
+    int completedDepth = 0;
+
+    Move killers[MAX_SEARCH_PLY][2] = {};
+    int history[COLOR_NB][SQUARE_NB][SQUARE_NB] = {};
+    Move pvTable[MAX_SEARCH_PLY + 1][MAX_SEARCH_PLY + 1] = {};
+    int pvLength[MAX_SEARCH_PLY + 1] = {};
+};
+
+} // namespace Search
+
+} // namespace Zugzwang
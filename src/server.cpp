@@ -0,0 +1,302 @@
+#include "pch.h"
+#include "server.h"
+#include "bitboard.h"
+#include "largepages.h"
+#include "search.h"
+#include "threadpool.h"
+#include "uci.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Zugzwang {
+
+namespace Server {
+
+namespace {
+
+using namespace std::chrono;
+
+constexpr int SessionHashMB = 1;
+
+// A search worker with its own table, so that sessions never see each other's entries
+struct Searcher {
+    Searcher() { tt.Resize(SessionHashMB); }
+
+    // As allocated, large pages round the table up to 2 MB
+    size_t Bytes() const {
+        return sizeof(Searcher) + tt.AllocatedBytes() + (worker.GetEvalCache().SizeMB() << 20);
+    }
+
+    TranspositionTable tt;
+    Search::Worker worker{ tt };
+};
+
+struct Session {
+    explicit Session(const std::string& name) : id(name) { pos.ParseFen(StartFEN); }
+
+    void NewGame() {
+        pos.ParseFen(StartFEN);
+        if (searcher) {
+            searcher->tt.Clear();
+            searcher->worker.Clear();
+        }
+    }
+
+    const std::string id;
+    Position pos;
+    std::unique_ptr<Searcher> searcher; // created by the first search, perft needs none
+    std::deque<std::string> pending; // guarded by Hub::mutex
+    bool scheduled = false;          // a job draining 'pending' is queued or running
+};
+
+// Owns the sessions and feeds their commands to the pool. A session is handed to at most one
+// worker at a time, which keeps its commands in order without locking its Position.
+class Hub {
+  public:
+    explicit Hub(int threads) : pool(threads), start(steady_clock::now()) {}
+
+    void Dispatch(const std::string& id, const std::string& cmd);
+    void Finish() { pool.Wait(); }
+    void Report();
+
+  private:
+    void drain(Session* session);
+    void execute(Session& session, const std::string& cmd, std::ostream& os);
+    void go(Session& session, std::istringstream& is, std::ostream& os);
+    void perft(Session& session, int depth, std::ostream& os);
+    void count(uint64_t n, uint64_t nanos);
+    void write(const std::string& id, const std::string& text);
+
+    std::unordered_map<std::string, std::unique_ptr<Session>> sessions;
+    size_t peakSessions = 0;
+    std::mutex mutex;       // sessions and their queues
+    std::mutex outputMutex; // keeps the lines of concurrent sessions whole
+
+    std::atomic<uint64_t> searches{ 0 };
+    std::atomic<uint64_t> nodes{ 0 };
+    std::atomic<uint64_t> searchNanos{ 0 };
+
+    // Declared last so that its workers are joined before the sessions go away
+    ThreadPool pool;
+    steady_clock::time_point start;
+};
+
+void Hub::Dispatch(const std::string& id, const std::string& cmd) {
+    std::lock_guard lock(mutex);
+
+    auto& session = sessions[id];
+    if (!session) {
+        session = std::make_unique<Session>(id);
+        peakSessions = std::max(peakSessions, sessions.size());
+    }
+
+    session->pending.push_back(cmd);
+    if (!session->scheduled) {
+        session->scheduled = true;
+        pool.Submit([this, s = session.get()] { drain(s); });
+    }
+}
+
+void Hub::drain(Session* session) {
+    std::unique_lock lock(mutex);
+
+    while (!session->pending.empty()) {
+        const std::string cmd = std::move(session->pending.front());
+        session->pending.pop_front();
+
+        if (cmd == "close" && session->pending.empty()) {
+            sessions.erase(sessions.find(session->id));
+            return;
+        }
+
+        lock.unlock();
+        std::ostringstream os;
+        if (cmd == "close") {
+            session->NewGame(); // the id is reused right away
+        } else {
+            execute(*session, cmd, os);
+        }
+        write(session->id, os.str());
+        lock.lock();
+    }
+    session->scheduled = false;
+}
+
+void Hub::execute(Session& session, const std::string& cmd, std::ostream& os) {
+    std::istringstream is(cmd);
+    std::string token;
+    is >> token;
+
+    if (token == "position") {
+        const std::streamoff offset = is.tellg();
+        UCI::SetPosition(session.pos,
+                         offset < 0 ? std::string_view() : is.view().substr(offset), os);
+    } else if (token == "go") {
+        go(session, is, os);
+    } else if (token == "ucinewgame") {
+        session.NewGame();
+    } else if (token == "isready") {
+        os << "readyok\n";
+    } else {
+        os << "Unknown command: '" << cmd << "'.\n";
+    }
+}
+
+void Hub::go(Session& session, std::istringstream& is, std::ostream& os) {
+    Search::Limits limits;
+    std::string token;
+
+    while (is >> token) {
+        if (token == "perft") {
+            int depth = 0;
+            is >> depth;
+            if (depth >= 1) {
+                perft(session, depth, os);
+            } else {
+                os << "info string Expected go perft <depth>\n";
+            }
+            return;
+        } else if (token == "depth") {
+            is >> limits.depth;
+        } else if (token == "nodes") {
+            is >> limits.nodes;
+        } else if (token == "movetime") {
+            is >> limits.movetime;
+        } else if (token == "wtime") {
+            is >> limits.time[WHITE];
+        } else if (token == "btime") {
+            is >> limits.time[BLACK];
+        } else if (token == "winc") {
+            is >> limits.inc[WHITE];
+        } else if (token == "binc") {
+            is >> limits.inc[BLACK];
+        } else if (token == "movestogo") {
+            is >> limits.movestogo;
+        }
+    }
+
+    // There is no stop per session, so every search has to end by itself
+    if (!limits.depth && !limits.nodes && !limits.movetime &&
+        !limits.time[session.pos.SideToMove()]) {
+        os << "info string Expected go depth, nodes, movetime or wtime/btime\n";
+        return;
+    }
+
+    if (!session.searcher) {
+        session.searcher = std::make_unique<Searcher>();
+    }
+    Search::Worker& worker = session.searcher->worker;
+
+    const auto t0 = steady_clock::now();
+    const auto& rootMoves = worker.Run(session.pos, limits, 1, &os);
+    count(worker.Nodes(), duration_cast<nanoseconds>(steady_clock::now() - t0).count());
+
+    if (rootMoves.empty()) {
+        os << "bestmove 0000\n";
+    } else if (rootMoves[0].pv.size() > 1) {
+        os << "bestmove " << UCI::FormatMove(rootMoves[0].pv[0]) << " ponder "
+           << UCI::FormatMove(rootMoves[0].pv[1]) << "\n";
+    } else {
+        os << "bestmove " << UCI::FormatMove(rootMoves[0].pv[0]) << "\n";
+    }
+}
+
+void Hub::perft(Session& session, int depth, std::ostream& os) {
+    const auto t0 = steady_clock::now();
+    const uint64_t n = session.pos.Perft(depth);
+    const uint64_t nanos = duration_cast<nanoseconds>(steady_clock::now() - t0).count();
+    count(n, nanos);
+
+    os << "info depth " << depth << " nodes " << n << " time " << nanos / 1000000 << " nps "
+       << n * 1000000000 / std::max<uint64_t>(nanos, 1) << "\n";
+    os << "perft " << n << "\n";
+}
+
+void Hub::count(uint64_t n, uint64_t nanos) {
+    searches.fetch_add(1, std::memory_order_relaxed);
+    nodes.fetch_add(n, std::memory_order_relaxed);
+    searchNanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void Hub::write(const std::string& id, const std::string& text) {
+    if (text.empty()) {
+        return;
+    }
+
+    std::string out;
+    for (size_t begin = 0, end; begin < text.size(); begin = end + 1) {
+        end = std::min(text.find('\n', begin), text.size());
+        out += id + ' ';
+        out.append(text, begin, end - begin);
+        out += '\n';
+    }
+
+    std::lock_guard lock(outputMutex);
+    std::cout << out << std::flush;
+}
+
+void Hub::Report() {
+    size_t live, peak;
+    {
+        std::lock_guard lock(mutex);
+        live = sessions.size();
+        peak = peakSessions;
+    }
+
+    const double secs = std::max(duration<double>(steady_clock::now() - start).count(), 1e-9);
+    const uint64_t n = nodes.load();
+    const double busySecs = std::max(searchNanos.load() / 1e9, 1e-9);
+    const LargePageMemory* tables = Bitboards::AttackTables();
+    const size_t searcherKB = std::make_unique<Searcher>()->Bytes() / 1024;
+
+    std::lock_guard lock(outputMutex);
+    std::cout << "info string " << live << " sessions (" << peak << " at most), "
+              << sizeof(Session) / 1024 << " KB per session and " << searcherKB
+              << " KB more once it searches, "
+              << (tables ? tables->Size() >> 10 : 0) << " KB of shared attack tables\n";
+    std::cout << "info string " << searches.load() << " searches, " << n << " nodes in "
+              << uint64_t(secs * 1000) << " ms on " << pool.Size()
+              << " threads: " << uint64_t(n / secs) << " nodes/sec aggregate, "
+              << uint64_t(n / busySecs) << " nodes/sec per search" << std::endl;
+}
+
+} // namespace
+
+void Run(int threads) {
+    Hub hub(threads);
+
+    std::cout << "info string Serving sessions on " << std::max(threads, 1)
+              << " threads, one '<session> <command>' per line" << std::endl;
+
+    std::string line, id, cmd;
+    while (std::getline(std::cin, line)) {
+        std::istringstream is(line);
+        id.clear();
+        cmd.clear();
+        is >> id >> std::ws;
+        std::getline(is, cmd);
+
+        if (id.empty() || id[0] == '#') {
+            continue;
+        }
+        if (!cmd.empty()) {
+            hub.Dispatch(id, cmd);
+        } else if (id == "stats") {
+            hub.Report();
+        } else if (id == "quit") {
+            break;
+        } else {
+            std::cout << "Unknown command: '" << line << "'.\n";
+        }
+    }
+
+    hub.Finish();
+    hub.Report();
+}
+
+} // namespace Server
+
+} // namespace Zugzwang
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Zugzwang {
+
+namespace Server {
+
+// Serves many independent games from one process. Every input line is "<session> <command>",
+// where the session is any token without spaces, and every output line carries the same prefix.
+// A session is created by its first command and owns its own Position; "position", "go perft <d>",
+// "go" with depth, nodes, movetime or clock limits, "ucinewgame", "isready" and "close" are
+// understood. The first search of a session gives it a Search::Worker and a small table of its
+// own. Commands of one session run in order, while different sessions share 'threads' workers and
+// the read-only Bitboards tables. The untagged commands "stats" and "quit" report the memory per
+// session and the aggregate throughput.
+void Run(int threads);
+
+} // namespace Server
+
+} // namespace Zugzwang
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "sharedmemory.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Zugzwang {
+
+namespace {
+
+std::string segmentName(const std::string& name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+} // namespace
+
+SharedMemory::SharedMemory(const std::string& name, size_t bytes) {
+    const std::string path = segmentName(name);
+
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        if (ftruncate(fd, off_t(bytes)) != 0) {
+            close(fd);
+            shm_unlink(path.c_str());
+            return;
+        }
+        created = true;
+    } else if (errno == EEXIST) {
+        fd = shm_open(path.c_str(), O_RDWR, 0);
+    }
+    if (fd < 0) {
+        return;
+    }
+
+    // A process that has just created the segment may not have sized it yet
+    struct stat st;
+    for (int tries = 0; fstat(fd, &st) == 0 && st.st_size == 0 && tries < 1000; ++tries) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (st.st_size > 0) {
+        void* p = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            data = p;
+            size = size_t(st.st_size);
+#ifdef MADV_HUGEPAGE
+            // Only honoured when shmem huge pages are enabled, harmless otherwise
+            madvise(data, size, MADV_HUGEPAGE);
+#endif
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+SharedMemory::~SharedMemory() { release(); }
+
+SharedMemory::SharedMemory(SharedMemory&& other) noexcept
+    : data(other.data), size(other.size), created(other.created) {
+    other.data = nullptr;
+    other.size = 0;
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept {
+    if (this != &other) {
+        release();
+        data = other.data;
+        size = other.size;
+        created = other.created;
+        other.data = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+bool SharedMemory::Unlink(const std::string& name) {
+    return shm_unlink(segmentName(name).c_str()) == 0;
+}
+
+void SharedMemory::release() {
+    if (data) {
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+} // namespace Zugzwang
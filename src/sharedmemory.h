@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Zugzwang {
+
+// A named POSIX shared-memory segment (shm_open() and mmap()) that any number of local processes
+// map at once. The first process to open a name creates the segment zero-filled at the size it
+// asks for; the others map it at the size it already has. Like a file, the segment outlives the
+// processes until it is removed with Unlink() or from /dev/shm.
+class SharedMemory {
+  public:
+    SharedMemory() = default;
+    // Names get a leading '/' if they have none. Data() is nullptr on failure.
+    SharedMemory(const std::string& name, size_t bytes);
+    ~SharedMemory();
+
+    SharedMemory(SharedMemory&& other) noexcept;
+    SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+    void* Data() const { return data; }
+    size_t Size() const { return size; }
+    // Whether this process created the segment rather than attached to it
+    bool Created() const { return created; }
+
+    // Removes the name, the memory is freed once the last process unmaps it
+    static bool Unlink(const std::string& name);
+
+  private:
+    void release();
+
+    void* data = nullptr;
+    size_t size = 0;
+    bool created = false;
+};
+
+} // namespace Zugzwang
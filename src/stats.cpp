@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "stats.h"
+#include <mutex>
+
+namespace Zugzwang {
+
+namespace Stats {
+
+#ifdef USE_STATS
+
+namespace {
+
+constexpr const char* CounterNames[COUNTER_NB] = {
+    "Move generator calls",
+    "Moves generated",
+    "Illegal moves rejected",
+    "IsSquareAttacked calls",
+    "GetAttacks calls",
+    "TT probes",
+    "TT hits",
+    "Eval cache probes",
+    "Eval cache hits",
+    "Cutoffs on move 1",
+    "Cutoffs on move 2",
+    "Cutoffs on move 3",
+    "Cutoffs on later moves",
+};
+
+// Percent of a over b, 0 if b is
+double percent(uint64_t a, uint64_t b) { return b ? 100.0 * a / b : 0; }
+
+// Every live thread registers its counters here; a thread that exits folds its counters into
+// 'retired' so that nothing is lost when worker threads come and go.
+std::mutex registryMutex;
+std::vector<ThreadStats*> registry;
+uint64_t retired[COUNTER_NB];
+
+} // namespace
+
+thread_local ThreadStats Local;
+
+ThreadStats::ThreadStats() {
+    for (auto& c : counters) {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (int i = 0; i < COUNTER_NB; ++i) {
+        retired[i] += counters[i].load(std::memory_order_relaxed);
+    }
+    std::erase(registry, this);
+}
+
+void Reset() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (int i = 0; i < COUNTER_NB; ++i) {
+        retired[i] = 0;
+        for (ThreadStats* ts : registry) {
+            ts->counters[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t Total(Counter c) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = retired[c];
+    for (const ThreadStats* ts : registry) {
+        total += ts->counters[c].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Print(std::ostream& os) {
+    uint64_t totals[COUNTER_NB];
+    for (int i = 0; i < COUNTER_NB; ++i) {
+        totals[i] = Total(Counter(i));
+    }
+
+    for (int i = 0; i < COUNTER_NB; ++i) {
+        os << "info string " << CounterNames[i] << ": " << totals[i] << "\n";
+    }
+
+    if (totals[GENERATE_CALLS]) {
+        os << "info string Moves per generation: " << std::fixed << std::setprecision(2)
+           << double(totals[MOVES_GENERATED]) / totals[GENERATE_CALLS]
+           << std::defaultfloat << "\n";
+    }
+
+    uint64_t cutoffs = 0;
+    for (int i = CUTOFFS_MOVE_1; i <= CUTOFFS_LATER_MOVES; ++i) {
+        cutoffs += totals[i];
+    }
+    os << std::fixed << std::setprecision(1) << "info string TT hit rate: "
+       << percent(totals[TT_HITS], totals[TT_PROBES]) << "%, eval cache hit rate: "
+       << percent(totals[EVAL_CACHE_HITS], totals[EVAL_CACHE_PROBES])
+       << "%, cutoffs on the first move: " << percent(totals[CUTOFFS_MOVE_1], cutoffs) << "%\n"
+       << std::defaultfloat;
+}
+
+#else
+
+void Reset() {}
+
+uint64_t Total(Counter) { return 0; }
+
+void Print(std::ostream& os) {
+    os << "info string Statistics are disabled, rebuild with -DZUGZWANG_STATS=ON\n";
+}
+
+#endif
+
+} // namespace Stats
+
+} // namespace Zugzwang
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "types.h"
+#include <algorithm>
+#include <atomic>
+#include <iosfwd>
+
+namespace Zugzwang {
+
+namespace Stats {
+
+enum Counter {
+    GENERATE_CALLS,
+    MOVES_GENERATED,
+    ILLEGAL_MOVES,
+    SQUARE_ATTACKED_CALLS,
+    ATTACK_LOOKUPS,
+    TT_PROBES,
+    TT_HITS,
+    EVAL_CACHE_PROBES,
+    EVAL_CACHE_HITS,
+
+    // Beta cutoffs of the main search by the index of the legal move that caused them
+    CUTOFFS_MOVE_1,
+    CUTOFFS_MOVE_2,
+    CUTOFFS_MOVE_3,
+    CUTOFFS_LATER_MOVES,
+
+    COUNTER_NB
+};
+
+#ifdef USE_STATS
+
+constexpr bool Enabled = true;
+
+// Counters owned by a single thread. Only the owner writes them, so a relaxed load/store pair is
+// enough and no lock prefix ends up on the hot path; readers on other threads see a slightly stale
+// but race-free value.
+struct alignas(64) ThreadStats {
+    ThreadStats();
+    ~ThreadStats();
+
+    std::atomic<uint64_t> counters[COUNTER_NB];
+};
+
+extern thread_local ThreadStats Local;
+
+inline void Inc(Counter c, uint64_t n = 1) {
+    auto& counter = Local.counters[c];
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+#else
+
+constexpr bool Enabled = false;
+
+inline void Inc(Counter, uint64_t = 1) {}
+
+#endif
+
+// Counts a beta cutoff by the 1-based index of the legal move that caused it
+inline void IncCutoff(int moveIndex) {
+    Inc(Counter(CUTOFFS_MOVE_1 + std::min(moveIndex, 4) - 1));
+}
+
+void Reset();
+void Print(std::ostream& os);
+
+// Sum over all threads, 0 when statistics are disabled
+uint64_t Total(Counter c);
+
+} // namespace Stats
+
+} // namespace Zugzwang
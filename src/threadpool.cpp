@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "threadpool.h"
+
+namespace Zugzwang {
+
+ThreadPool::ThreadPool(int threads) {
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+    {
+        std::lock_guard lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock lock(mutex);
+    allIdle.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock lock(mutex);
+
+    while (true) {
+        jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return; // stopping, and nothing left to run
+        }
+
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        ++running;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        if (--running == 0 && jobs.empty()) {
+            allIdle.notify_all();
+        }
+    }
+}
+
+} // namespace Zugzwang
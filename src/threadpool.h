@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Zugzwang {
+
+// Fixed set of worker threads running submitted jobs in FIFO order
+class ThreadPool {
+  public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool(); // runs the jobs still queued before joining the workers
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> job);
+
+    // Blocks until the queue is empty and no worker is running a job
+    void Wait();
+
+    int Size() const { return int(workers.size()); }
+
+  private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable allIdle;
+    int running = 0;
+    bool stopping = false;
+};
+
+} // namespace Zugzwang
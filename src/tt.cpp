@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "tt.h"
+#include "position.h"
+#include <atomic>
+#include <thread>
+
+namespace Zugzwang {
+
+void TTEntry::Save(Key key, int s, Bound bound, int d, Move m, uint8_t generation) {
+    const uint16_t k = uint16_t(key);
+
+    // Keep the move of a previous search of this position unless there is a new one
+    if (m || k != key16) {
+        move = m.Raw();
+    }
+
+    // Prefer deeper results for the same position, but never lose an exact score to a bound
+    if (k != key16 || bound == BOUND_EXACT || d + 4 > depth8) {
+        key16 = k;
+        score = int16_t(s);
+        depth8 = uint8_t(d + 1);
+        genBound = uint8_t(generation | bound);
+    }
+}
+
+bool TranspositionTable::Resize(size_t mb) {
+    const size_t count = std::max<size_t>(mb, 1) * 1024 * 1024 / sizeof(Cluster);
+    return sharedName.empty() ? allocatePrivate(count) : attachShared(sharedName, count);
+}
+
+void TranspositionTable::Clear() {
+    if (sharedName.empty()) {
+        std::memset(table, 0, clusterCount * sizeof(Cluster));
+        generation = 0;
+    }
+}
+
+bool TranspositionTable::Share(const std::string& name) {
+    if (name == sharedName) {
+        return true;
+    }
+    return name.empty() ? allocatePrivate(clusterCount) : attachShared(name, clusterCount);
+}
+
+bool TranspositionTable::allocatePrivate(size_t count) {
+    LargePageMemory newMemory(count * sizeof(Cluster));
+    if (!newMemory.Data()) {
+        return false;
+    }
+
+    memory = std::move(newMemory);
+    shared = SharedMemory();
+    sharedName.clear();
+    table = static_cast<Cluster*>(memory.Data());
+    clusterCount = count;
+    return true;
+}
+
+bool TranspositionTable::attachShared(const std::string& name, size_t count) {
+    SharedMemory segment(name, sizeof(SharedHeader) + count * sizeof(Cluster));
+    if (!segment.Data() || segment.Size() < sizeof(SharedHeader)) {
+        return false;
+    }
+
+    auto* const header = static_cast<SharedHeader*>(segment.Data());
+    std::atomic_ref<uint64_t> magic(header->magic);
+
+    if (segment.Created()) {
+        header->keySignature = Position::KeySignature();
+        header->clusterSize = sizeof(Cluster);
+        header->clusterCount = count;
+        magic.store(SharedMagic, std::memory_order_release);
+    } else {
+        // The process that created the segment may still be filling in the header
+        for (int tries = 0; !magic.load(std::memory_order_acquire) && tries < 1000; ++tries) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (magic.load(std::memory_order_acquire) != SharedMagic ||
+            header->keySignature != Position::KeySignature() ||
+            header->clusterSize != sizeof(Cluster) ||
+            segment.Size() < sizeof(SharedHeader) + header->clusterCount * sizeof(Cluster)) {
+            return false;
+        }
+        count = header->clusterCount;
+    }
+
+    shared = std::move(segment);
+    memory = LargePageMemory();
+    sharedName = name;
+    table = reinterpret_cast<Cluster*>(header + 1);
+    clusterCount = count;
+    return true;
+}
+
+TTEntry* TranspositionTable::Probe(Key key, bool& found) const {
+    // Multiply-shift maps the key onto the clusters without needing a power of two
+    const size_t index = size_t((unsigned __int128)key * clusterCount >> 64);
+    TTEntry* const entries = table[index].entries;
+    const uint16_t k = uint16_t(key);
+    Stats::Inc(Stats::TT_PROBES);
+
+    for (int i = 0; i < ClusterSize; ++i) {
+        if (entries[i].key16 == k && entries[i].depth8) {
+            Stats::Inc(Stats::TT_HITS);
+            // Refresh the generation so that a hit is not the first thing replaced
+            entries[i].genBound = uint8_t(generation | (entries[i].genBound & 3));
+            found = true;
+            return &entries[i];
+        }
+    }
+
+    // Replace the shallowest entry, counting each search of age as eight plies of depth
+    TTEntry* replace = entries;
+    auto worth = [this](const TTEntry& e) {
+        return e.depth8 - 2 * uint8_t(generation - (e.genBound & 0xFC));
+    };
+    for (int i = 1; i < ClusterSize; ++i) {
+        if (worth(entries[i]) < worth(*replace)) {
+            replace = &entries[i];
+        }
+    }
+    found = false;
+    return replace;
+}
+
+int TranspositionTable::Hashfull() const {
+    int count = 0;
+    for (int i = 0; i < 1000 / ClusterSize; ++i) {
+        for (const auto& e : table[i].entries) {
+            count += e.depth8 && (e.genBound & 0xFC) == generation;
+        }
+    }
+    return count * 1000 / (1000 / ClusterSize * ClusterSize);
+}
+
+void EvalCache::Resize(size_t mb) {
+    const size_t count = mb ? std::bit_floor(mb * 1024 * 1024 / sizeof(Entry)) : 0;
+
+    entries.assign(count, Entry{ 0, VALUE_NONE });
+    entries.shrink_to_fit();
+    mask = count ? count - 1 : 0;
+}
+
+void EvalCache::Clear() {
+    std::fill(entries.begin(), entries.end(), Entry{ 0, VALUE_NONE });
+}
+
+} // namespace Zugzwang
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "largepages.h"
+#include "sharedmemory.h"
+#include "stats.h"
+#include "types.h"
+#include <string>
+#include <vector>
+
+namespace Zugzwang {
+
+enum Bound : uint8_t {
+    BOUND_NONE,
+    BOUND_UPPER, // the score is at most this, all moves failed low
+    BOUND_LOWER, // the score is at least this, a move failed high
+    BOUND_EXACT = BOUND_UPPER | BOUND_LOWER
+};
+
+// 8 bytes: the lower 16 bits of the key identify the position within its cluster. The upper
+// bits pick the cluster, so they would tell nothing apart in a table of 65536 clusters or more.
+struct TTEntry {
+    Move GetMove() const { return Move(move); }
+    int Score() const { return score; }
+    int Depth() const { return depth8 - 1; }
+    Bound GetBound() const { return Bound(genBound & 3); }
+
+    void Save(Key key, int score, Bound bound, int depth, Move move, uint8_t generation);
+
+  private:
+    friend class TranspositionTable;
+
+    uint16_t key16;
+    uint16_t move;
+    int16_t score;
+    uint8_t depth8;   // depth + 1, so that 0 marks an empty entry
+    uint8_t genBound; // search generation in the upper 6 bits, Bound in the lower 2
+};
+
+static_assert(sizeof(TTEntry) == 8);
+
+// Clusters of four entries, allocated on large pages where the system has them, or in a named
+// shared-memory segment that several engine processes probe and store into at once. Entries are
+// not locked either way: a torn or foreign entry is no worse than a key16 collision, its move is
+// only used to order the moves and its bound only for a position with the same key16.
+class TranspositionTable {
+  public:
+    static constexpr int ClusterSize = 4;
+
+    // Drops the contents. Returns false, keeping the old table, if the memory is not available.
+    // A shared table is mapped again: the size only applies if its segment has to be created.
+    bool Resize(size_t mb);
+    // A shared table is left as it is, its entries belong to every process that maps it
+    void Clear();
+
+    // Moves the table into the named segment at its current size, or attaches to the segment if
+    // another process created it; an empty name moves it back into private memory. Returns false,
+    // keeping the old table, if the segment cannot be mapped or was created by a build with other
+    // Zobrist keys or another entry layout.
+    bool Share(const std::string& name);
+    const std::string& SharedName() const { return sharedName; }
+
+    // Called before each search so that entries of older searches are replaced first
+    void NewSearch() { generation += 4; }
+    uint8_t Generation() const { return generation; }
+
+    // Returns the entry of the position if found is set, otherwise the entry to replace
+    TTEntry* Probe(Key key, bool& found) const;
+
+    // Permille of the first thousand entries written by the current search, for "info hashfull"
+    int Hashfull() const;
+
+    size_t SizeMB() const { return clusterCount * sizeof(Cluster) >> 20; }
+    // Of the mapping, which can be larger than the table
+    size_t AllocatedBytes() const { return sharedName.empty() ? memory.Size() : shared.Size(); }
+
+  private:
+    struct Cluster {
+        TTEntry entries[ClusterSize];
+    };
+
+    // At the start of a shared segment, the clusters follow on the next cache line
+    struct alignas(64) SharedHeader {
+        uint64_t magic; // SharedMagic, stored last by the process that creates the segment
+        Key keySignature;
+        uint64_t clusterSize;
+        uint64_t clusterCount;
+    };
+
+    static constexpr uint64_t SharedMagic = 0x314853545A5A; // "ZZTSH1"
+
+    bool allocatePrivate(size_t count);
+    bool attachShared(const std::string& name, size_t count);
+
+    LargePageMemory memory;
+    SharedMemory shared; // holds the table instead of 'memory' when sharedName is set
+    std::string sharedName;
+    Cluster* table = nullptr;
+    size_t clusterCount = 0;
+    uint8_t generation = 0;
+};
+
+// Static evaluations of recently evaluated positions, one entry per slot. Each search thread owns
+// its own, so nothing is locked or shared; a size of zero turns it off.
+class EvalCache {
+  public:
+    static constexpr int DefaultSizeMB = 1;
+    static constexpr int MaxSizeMB = 1024;
+
+    // Drops the contents, the entry count is rounded down to a power of two
+    void Resize(size_t mb);
+    void Clear();
+
+    bool Probe(Key key, int& eval) {
+        ++probes;
+        Stats::Inc(Stats::EVAL_CACHE_PROBES);
+        if (entries.empty()) {
+            return false;
+        }
+        const Entry& e = entries[key & mask];
+        if (e.key32 != uint32_t(key >> 32) || e.eval == VALUE_NONE) {
+            return false;
+        }
+        ++hits;
+        Stats::Inc(Stats::EVAL_CACHE_HITS);
+        eval = e.eval;
+        return true;
+    }
+
+    void Store(Key key, int eval) {
+        if (!entries.empty()) {
+            entries[key & mask] = { uint32_t(key >> 32), int32_t(eval) };
+        }
+    }
+
+    // Probes and hits since the last ResetCounters()
+    uint64_t Probes() const { return probes; }
+    uint64_t Hits() const { return hits; }
+    void ResetCounters() { probes = hits = 0; }
+
+    size_t SizeMB() const { return entries.size() * sizeof(Entry) >> 20; }
+
+  private:
+    // The lower bits of the key give the slot, the upper 32 tell positions in it apart
+    struct Entry {
+        uint32_t key32;
+        int32_t eval; // VALUE_NONE when empty
+    };
+
+    std::vector<Entry> entries;
+    size_t mask = 0;
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
+
+// Mate scores are stored relative to the position rather than the root
+constexpr int ScoreToTT(int score, int ply) {
+    return score >= VALUE_MATE_IN_MAX_PLY ? score + ply
+         : score <= -VALUE_MATE_IN_MAX_PLY ? score - ply
+                                            : score;
+}
+
+constexpr int ScoreFromTT(int score, int ply) {
+    return score >= VALUE_MATE_IN_MAX_PLY ? score - ply
+         : score <= -VALUE_MATE_IN_MAX_PLY ? score + ply
+                                            : score;
+}
+
+} // namespace Zugzwang
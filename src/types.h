@@ -11,6 +11,15 @@ using Key = uint64_t;
 
 constexpr int MAX_MOVES = 256;
 constexpr int MAX_PLIES = 2048;
+constexpr int MAX_SEARCH_PLY = 128;
+
+// Scores in centipawns from the side to move's point of view. Mate scores count the plies from
+// the root: VALUE_MATE - n means mate in n plies.
+constexpr int VALUE_DRAW = 0;
+constexpr int VALUE_MATE = 32000;
+constexpr int VALUE_INFINITE = 32001;
+constexpr int VALUE_NONE = 32002;
+constexpr int VALUE_MATE_IN_MAX_PLY = VALUE_MATE - MAX_SEARCH_PLY;
 
 // clang-format off
 enum PieceType {
@@ -18,14 +27,14 @@ enum PieceType {
     PIECE_TYPE_NB = 8
 };
 
-enum Piece {
+enum Piece : uint8_t {
     NO_PIECE,
     W_PAWN = PAWN,     W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
     B_PAWN = PAWN + 8, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING,
     PIECE_NB = 16
 };
 
-enum Color { WHITE, BLACK, COLOR_NB = 2 };
+enum Color : uint8_t { WHITE, BLACK, COLOR_NB = 2 };
 
 enum CastlingRights {
     NO_CASTLING,
@@ -148,6 +157,8 @@ class Move {
 
     constexpr bool IsOk() const { return None().data != data; }
 
+    constexpr uint16_t Raw() const { return data; }
+
     static constexpr Move None() { return Move(0); }
 
     constexpr bool operator==(const Move& m) const { return data == m.data; }
@@ -165,6 +176,8 @@ class MoveList {
         moves[count++] = move;
     }
 
+    int Size() const { return count; }
+
     Move& operator[](int i) {
         assert(i >= 0 && i < count);
         return moves[i];
@@ -1,13 +1,21 @@
 #include "pch.h"
+#include "analyse.h"
+#include "benchmark.h"
+#include "datagen.h"
+#include "distperft.h"
+#include "match.h"
 #include "movegen.h"
+#include "pgnindex.h"
+#include "server.h"
+#include "sharedmemory.h"
+#include "stats.h"
 #include "uci.h"
+#include <algorithm>
 
 namespace Zugzwang {
 
 namespace {
 
-constexpr const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-
 bool isMoveStr(std::string_view str) {
     auto IsFileValid = [](char ch) { return ch >= 'a' && ch <= 'h'; };
     auto IsRankValid = [](char ch) { return ch >= '1' && ch <= '8'; };
@@ -29,15 +37,44 @@ bool isMoveStr(std::string_view str) {
     return true;
 }
 
+// Splits off the next space-separated token, returning an empty view at the end of the input
+std::string_view nextToken(std::string_view& str) {
+    const size_t start = std::min(str.find_first_not_of(' '), str.size());
+    const size_t end = std::min(str.find(' ', start), str.size());
+
+    const std::string_view token = str.substr(start, end - start);
+    str.remove_prefix(end);
+    return token;
+}
+
+constexpr int DefaultHashMB = 16;
+constexpr int MaxHashMB = 65536;
+
 } // namespace
 
-UCIEngine::UCIEngine(int argc, char** argv) : board() { board.ParseFen(StartFEN); }
+UCIEngine::UCIEngine(int argc, char** argv) : board() {
+    board.ParseFen(StartFEN);
+
+    if (!tt.Resize(DefaultHashMB)) {
+        std::cerr << "Failed to allocate the transposition table\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        commandLine += std::string(argv[i]) + " ";
+    }
+}
 
 void UCIEngine::Loop() {
     std::string token, cmd;
 
-    while (true) {
-        if (!getline(std::cin, cmd)) {
+    // Commands given on the command line are run once, without entering the interactive loop
+    const bool interactive = commandLine.empty();
+
+    do {
+        if (!interactive) {
+            cmd = commandLine;
+        } else if (!getline(std::cin, cmd)) {
             cmd = "quit";
         }
 
@@ -46,80 +83,507 @@ void UCIEngine::Loop() {
         token.clear();
         is >> std::skipws >> token;
 
+        // Only these are handled while a search runs, anything else waits for it to finish
+        if (token != "isready" && token != "stop" && token != "ponderhit" && token != "quit") {
+            waitForSearch();
+        }
+
         if (token == "uci") {
             std::cout << "id name Zugzwang 1.0\nid author Paul\n";
+            std::cout << "option name Hash type spin default " << DefaultHashMB << " min 1 max "
+                      << MaxHashMB << "\n";
+            std::cout << "option name EvalCache type spin default " << EvalCache::DefaultSizeMB
+                      << " min 0 max " << EvalCache::MaxSizeMB << "\n";
+            std::cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MOVES << "\n";
+            std::cout << "option name Ponder type check default false\n";
+            std::cout << "option name SharedHash type string default <empty>\n";
+            std::cout << "option name Remove SharedHash type button\n";
             std::cout << "uciok\n";
         } else if (token == "isready") {
             std::cout << "readyok\n";
+        } else if (token == "setoption") {
+            setOption(is);
+        } else if (token == "ucinewgame") {
+            tt.Clear();
+            searcher.Clear();
         } else if (token == "position") {
             position(is);
             // board.Print();
         } else if (token == "go") {
             go(is);
+        } else if (token == "stop") {
+            stop();
+        } else if (token == "ponderhit") {
+            ponderHit();
+        } else if (token == "debug") {
+            is >> token;
+            debug = (token == "on");
+        } else if (token == "stats") {
+            Stats::Print(std::cout);
+        } else if (token == "bench") {
+            bench(is);
+        } else if (token == "gensfen") {
+            gensfen(is);
+        } else if (token == "analyse") {
+            analyse(is);
+        } else if (token == "distperft") {
+            distPerft(is);
+        } else if (token == "match") {
+            match(is);
+        } else if (token == "pgnindex") {
+            pgnIndex(is);
+        } else if (token == "pgnprobe") {
+            pgnProbe(is);
+        } else if (token == "server") {
+            server(is);
+            break;
         } else if (token == "quit") {
+            stop();
             break;
         } else if (!token.empty() && token[0] != '#') {
             std::cout << "Unknown command: '" << cmd << "'.\n";
         }
+    } while (interactive);
+
+    waitForSearch();
+}
+
+void UCIEngine::analyse(std::istringstream& is) {
+    Analyse::Options options;
+    std::string token;
+
+    is >> options.input;
+    while (is >> token) {
+        if (token == "depth") {
+            is >> options.depth;
+        } else if (token == "nodes") {
+            is >> options.nodes;
+        } else if (token == "threads") {
+            is >> options.threads;
+        } else if (token == "hash") {
+            is >> options.hashMB;
+        }
+    }
+
+    if (options.input.empty()) {
+        std::cout << "Usage: analyse <epd file> [depth <d>] [nodes <n>] [threads <t>] "
+                     "[hash <mb>]\n";
+        return;
+    }
+    Analyse::Run(options);
+}
+
+void UCIEngine::distPerft(std::istringstream& is) {
+    DistPerft::Options options;
+    std::string token;
+
+    is >> options.depth;
+    while (is >> token) {
+        if (token == "split") {
+            is >> options.splitPly;
+        } else if (token == "workers") {
+            is >> options.workers;
+        } else if (token == "checkpoint") {
+            is >> options.checkpoint;
+        }
+    }
+
+    if (options.depth < 2) {
+        std::cout << "Usage: distperft <depth> [split <ply>] [workers <n>] [checkpoint <file>]\n";
+        return;
+    }
+    DistPerft::Run(board, options);
+}
+
+void UCIEngine::bench(std::istringstream& is) {
+    std::string token, file;
+    is >> token >> file;
+
+    if (token == "perft") {
+        Benchmark::Perft();
+    } else if (token == "sliders") {
+        Benchmark::Sliders();
+    } else if (token == "movegen") {
+        Benchmark::Generators();
+    } else if (token == "largepages") {
+        Benchmark::LargePages();
+    } else if (token == "makemove") {
+        Benchmark::MoveMaking();
+    } else if (token == "attacks") {
+        Benchmark::Attacks();
+    } else if (token == "legality") {
+        Benchmark::Legality();
+    } else if (token == "mate") {
+        Benchmark::Mates();
+    } else if (token == "tt") {
+        Benchmark::HashTable();
+    } else if (token == "multipv") {
+        Benchmark::MultiPV(file.empty() ? 4 : std::max(std::atoi(file.c_str()), 1));
+    } else if (token == "fen" && !file.empty()) {
+        Benchmark::FenThroughput(file);
+    } else if (token == "packed" && !file.empty()) {
+        Benchmark::PackedRoundTrip(file);
+    } else if (token == "records" && !file.empty()) {
+        Benchmark::RecordDecode(file);
+    } else if (token == "batch" && !file.empty()) {
+        Benchmark::BatchAnalysis(file);
+    } else {
+        std::cout << "Usage: bench perft|sliders|movegen|largepages|makemove|attacks|legality|"
+                     "mate|tt, bench multipv [lines], bench fen|packed|batch <fen file> or bench "
+                     "records <gensfen file>\n";
+    }
+}
+
+void UCIEngine::match(std::istringstream& is) {
+    Match::Options options;
+    std::string token;
+    bool valid = true;
+
+    is >> options.openings;
+    while (is >> token) {
+        if (token == "games") {
+            is >> options.games;
+        } else if (token == "threads") {
+            is >> options.threads;
+        } else if (token == "tc") {
+            // Seconds like "10+0.1", as cutechess and fastchess take them
+            std::string tc;
+            is >> tc;
+            const size_t plus = tc.find('+');
+            options.time = int64_t(std::atof(tc.substr(0, plus).c_str()) * 1000);
+            options.inc = plus == std::string::npos
+                ? 0
+                : int64_t(std::atof(tc.substr(plus + 1).c_str()) * 1000);
+        } else if (token == "engine1" || token == "engine2") {
+            std::string config;
+            is >> config;
+            valid &= Match::ParseConfig(config, options.engines[token == "engine2"]);
+        } else if (token == "elo0") {
+            is >> options.elo0;
+        } else if (token == "elo1") {
+            is >> options.elo1;
+        } else if (token == "alpha") {
+            is >> options.alpha;
+        } else if (token == "beta") {
+            is >> options.beta;
+        }
+    }
+
+    if (options.openings.empty() || !valid || options.time <= 0) {
+        std::cout << "Usage: match <epd file> [games <n>] [threads <t>] [tc <s>+<inc s>] "
+                     "[engine1 Hash=<mb>,EvalCache=<mb>] [engine2 ...] [elo0 <e>] [elo1 <e>] "
+                     "[alpha <a>] [beta <b>]\n";
+        return;
+    }
+    Match::Run(options);
+}
+
+void UCIEngine::pgnIndex(std::istringstream& is) {
+    PgnIndex::Options options;
+    std::string token;
+
+    is >> options.input;
+    while (is >> token) {
+        if (token == "output") {
+            is >> options.output;
+        } else if (token == "threads") {
+            is >> options.threads;
+        } else if (token == "plies") {
+            is >> options.plies;
+        }
+    }
+
+    if (options.input.empty()) {
+        std::cout << "Usage: pgnindex <pgn file> [output <index file>] [threads <t>] [plies <n>]\n";
+        return;
+    }
+    PgnIndex::Build(options);
+}
+
+void UCIEngine::pgnProbe(std::istringstream& is) {
+    std::string file;
+    is >> file;
+
+    if (file.empty()) {
+        std::cout << "Usage: pgnprobe <index file>\n";
+        return;
+    }
+    PgnIndex::Probe(file, board);
+}
+
+void UCIEngine::gensfen(std::istringstream& is) {
+    DataGen::Options options;
+    std::string token;
+
+    while (is >> token) {
+        if (token == "count") {
+            is >> options.count;
+        } else if (token == "threads") {
+            is >> options.threads;
+        } else if (token == "random_plies") {
+            is >> options.randomPlies;
+        } else if (token == "depth") {
+            is >> options.depth;
+        } else if (token == "nodes") {
+            is >> options.nodes;
+        } else if (token == "seed") {
+            is >> options.seed;
+        } else if (token == "output") {
+            is >> options.output;
+        }
+    }
+
+    DataGen::Run(options);
+}
+
+void UCIEngine::server(std::istringstream& is) {
+    std::string token;
+    int threads = 1;
+
+    while (is >> token) {
+        if (token == "threads") {
+            is >> threads;
+        }
     }
+
+    Server::Run(threads);
 }
 
 void UCIEngine::go(std::istringstream& is) {
+    Search::Limits limits;
     std::string token;
-    is >> token;
-    if (token != "perft") {
+
+    while (is >> token) {
+        if (token == "perft") {
+            int depth = 0;
+            is >> depth;
+            if (depth >= 1) {
+                Stats::Reset();
+                board.PerftTest(depth);
+
+                if (debug) {
+                    Stats::Print(std::cout);
+                }
+            }
+            return;
+        } else if (token == "depth") {
+            is >> limits.depth;
+        } else if (token == "nodes") {
+            is >> limits.nodes;
+        } else if (token == "movetime") {
+            is >> limits.movetime;
+        } else if (token == "wtime") {
+            is >> limits.time[WHITE];
+        } else if (token == "btime") {
+            is >> limits.time[BLACK];
+        } else if (token == "winc") {
+            is >> limits.inc[WHITE];
+        } else if (token == "binc") {
+            is >> limits.inc[BLACK];
+        } else if (token == "movestogo") {
+            is >> limits.movestogo;
+        } else if (token == "infinite") {
+            limits.infinite = true;
+        } else if (token == "mate") {
+            is >> limits.mate;
+        } else if (token == "ponder") {
+            pondering = true;
+        }
+    }
+
+    if (limits.mate > 0) {
+        pondering = false;
+        goMate(limits);
+        return;
+    }
+
+    // The search thread owns the board until it has printed its bestmove
+    Stats::Reset();
+    infinite = limits.infinite;
+    searcher.Prepare(pondering);
+    ponderSearches += pondering;
+
+    searchThread = std::thread([this, limits] {
+        const auto& rootMoves = searcher.Run(board, limits, multiPV, &std::cout);
+
+        if (rootMoves.empty()) {
+            std::cout << "bestmove 0000" << std::endl;
+        } else if (rootMoves[0].pv.size() > 1) {
+            std::cout << "bestmove " << UCI::FormatMove(rootMoves[0].pv[0]) << " ponder "
+                      << UCI::FormatMove(rootMoves[0].pv[1]) << std::endl;
+        } else {
+            std::cout << "bestmove " << UCI::FormatMove(rootMoves[0].pv[0]) << std::endl;
+        }
+
+        if (debug) {
+            Stats::Print(std::cout);
+        }
+    });
+}
+
+void UCIEngine::goMate(const Search::Limits& limits) {
+    mateSolver.Prepare();
+
+    searchThread = std::thread([this, limits] {
+        const Mate::Result result = mateSolver.Run(board, limits.mate, limits, &std::cout);
+
+        Move best = result.pv.empty() ? Move::None() : result.pv[0];
+        if (!result.mateIn) {
+            std::cout << "info string No mate in " << limits.mate << " found" << std::endl;
+
+            // Any legal move will do for the bestmove that has to follow
+            MoveList list;
+            MoveGen::GeneratePseudo(board, list);
+            for (const auto move : list) {
+                if (board.MakeMove(move)) {
+                    board.UnmakeMove(move);
+                    best = move;
+                    break;
+                }
+            }
+        }
+
+        std::cout << "bestmove " << UCI::FormatMove(best);
+        if (result.pv.size() > 1) {
+            std::cout << " ponder " << UCI::FormatMove(result.pv[1]);
+        }
+        std::cout << std::endl;
+    });
+}
+
+// A stop during a ponder search means the opponent played another move than the expected one
+void UCIEngine::stop() {
+    if (!searchThread.joinable()) {
         return;
     }
 
-    int depth;
-    is >> depth;
-    if (depth >= 1) {
-        board.PerftTest(depth);
+    if (pondering) {
+        pondering = false;
+        printPonderHitRate();
     }
+    infinite = false;
+    searcher.Stop();
+    mateSolver.Stop();
+    searchThread.join();
 }
 
-void UCIEngine::position(std::istringstream& is) {
-    std::string token, fen;
+// The search goes on from where it is, only now on our clock
+void UCIEngine::ponderHit() {
+    if (!pondering) {
+        return;
+    }
 
+    pondering = false;
+    ++ponderHits;
+    searcher.PonderHit();
+    printPonderHitRate();
+}
+
+void UCIEngine::waitForSearch() {
+    if (pondering || infinite) {
+        stop(); // a ponder or infinite search never ends on its own
+    } else if (searchThread.joinable()) {
+        searchThread.join();
+    }
+}
+
+void UCIEngine::printPonderHitRate() const {
+    std::cout << "info string Ponder hit rate: " << ponderHits << "/" << ponderSearches << " ("
+              << ponderHits * 100 / std::max<uint64_t>(ponderSearches, 1) << "%)" << std::endl;
+}
+
+void UCIEngine::setOption(std::istringstream& is) {
+    std::string token, name, value;
+
+    // "setoption name <id> [value <x>]", where the name may have spaces
     is >> token;
+    while (is >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    is >> value;
+
+    if (name == "Hash") {
+        const int mb = std::clamp(std::atoi(value.c_str()), 1, MaxHashMB);
+        if (!tt.Resize(mb)) {
+            std::cout << "info string Unable to allocate " << mb << " MB, keeping "
+                      << tt.SizeMB() << " MB\n";
+        }
+    } else if (name == "EvalCache") {
+        searcher.ResizeEvalCache(std::clamp(std::atoi(value.c_str()), 0, EvalCache::MaxSizeMB));
+    } else if (name == "MultiPV") {
+        multiPV = std::clamp(std::atoi(value.c_str()), 1, MAX_MOVES);
+    } else if (name == "Ponder") {
+        // Only tells whether the GUI will send "go ponder", nothing to set up
+    } else if (name == "SharedHash") {
+        const std::string segment = value == "<empty>" ? "" : value;
+        if (!tt.Share(segment)) {
+            std::cout << "info string Unable to share the hash in '" << segment
+                      << "', a build with other keys may have created it\n";
+        } else if (!segment.empty()) {
+            std::cout << "info string Hash shared in '" << segment << "', " << tt.SizeMB()
+                      << " MB\n";
+        }
+    } else if (name == "Remove SharedHash") {
+        // Only the name goes, the processes that have the segment mapped keep searching with it
+        if (tt.SharedName().empty() || !SharedMemory::Unlink(tt.SharedName())) {
+            std::cout << "info string No shared hash segment to remove\n";
+        }
+    } else {
+        std::cout << "info string Unknown option: '" << name << "'\n";
+    }
+}
+
+void UCIEngine::position(std::istringstream& is) {
+    // Work on views into the command line rather than copying tokens around
+    const std::streamoff offset = is.tellg();
+    UCI::SetPosition(board, offset < 0 ? std::string_view() : is.view().substr(offset), std::cout);
+}
+
+namespace UCI {
+
+bool SetPosition(Position& pos, std::string_view args, std::ostream& os) {
+    std::string_view fen;
+
+    const std::string_view token = nextToken(args);
     if (token == "startpos") {
         fen = StartFEN;
-        is >> token; // Consume the "moves" token, if any
+        nextToken(args); // Consume the "moves" token, if any
     } else if (token == "fen") {
-        while (is >> token && token != "moves") {
-            fen += token + " ";
-        }
+        const size_t movesPos = args.find("moves");
+        fen = args.substr(0, movesPos);
+        args.remove_prefix(movesPos == std::string_view::npos ? args.size() : movesPos + 5);
+        fen.remove_prefix(std::min(fen.find_first_not_of(' '), fen.size()));
     } else {
-        return;
+        return false;
     }
 
-    std::vector<std::string> moves;
-
-    while (is >> token) {
-        moves.push_back(token);
+    if (!pos.ParseFen(fen)) {
+        os << "info string Invalid FEN: '" << fen << "'\n";
+        pos.ParseFen(StartFEN);
+        return false;
     }
 
-    board.ParseFen(fen);
-    for (const auto& move : moves) {
+    for (std::string_view move = nextToken(args); !move.empty(); move = nextToken(args)) {
         if (!isMoveStr(move)) {
             break;
         }
 
-        Move mv = parseMove(move);
+        Move mv = ParseMove(pos, move);
         if (mv == Move::None()) {
             break;
         }
 
-        board.MakeMove(mv);
+        pos.MakeMove(mv);
     }
+    return true;
 }
 
-Move UCIEngine::parseMove(std::string_view str) const {
+Move ParseMove(const Position& pos, std::string_view str) {
     Square from = MakeSquare(File(str[0] - 'a'), Rank(str[1] - '1'));
     Square to = MakeSquare(File(str[2] - 'a'), Rank(str[3] - '1'));
 
     MoveList list;
-    MoveGen::GeneratePseudo(board, list);
+    MoveGen::GeneratePseudo(pos, list);
 
     for (const auto move : list) {
         if (move.FromSq() == from && move.ToSq() == to) {
@@ -137,4 +601,29 @@ Move UCIEngine::parseMove(std::string_view str) const {
     return Move::None();
 }
 
+std::string FormatMove(Move move) {
+    if (!move) {
+        return "0000";
+    }
+
+    const Square from = move.FromSq();
+    const Square to = move.ToSq();
+    std::string str = { char('a' + FileOf(from)), char('1' + RankOf(from)), char('a' + FileOf(to)),
+                        char('1' + RankOf(to)) };
+    if (move.TypeOf() == PROMOTION) {
+        str += " nbrq"[move.PromotionType() - PAWN];
+    }
+    return str;
+}
+
+std::string FormatScore(int score) {
+    if (std::abs(score) >= VALUE_MATE_IN_MAX_PLY) {
+        const int moves = score > 0 ? (VALUE_MATE - score + 1) / 2 : -(VALUE_MATE + score) / 2;
+        return "mate " + std::to_string(moves);
+    }
+    return "cp " + std::to_string(score);
+}
+
+} // namespace UCI
+
 } // namespace Zugzwang
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "mate.h"
 #include "position.h"
+#include "search.h"
+#include "tt.h"
 #include <iosfwd>
 #include <string_view>
+#include <thread>
 
 namespace Zugzwang {
 
@@ -12,11 +16,52 @@ class UCIEngine {
     void Loop();
 
   private:
+    void analyse(std::istringstream& is);
+    void bench(std::istringstream& is);
+    void distPerft(std::istringstream& is);
+    void gensfen(std::istringstream& is);
     void go(std::istringstream& is);
+    void goMate(const Search::Limits& limits);
+    void match(std::istringstream& is);
+    void pgnIndex(std::istringstream& is);
+    void pgnProbe(std::istringstream& is);
     void position(std::istringstream& is);
-    Move parseMove(std::string_view str) const;
+    void server(std::istringstream& is);
+    void setOption(std::istringstream& is);
+    void stop();
+    void ponderHit();
+    void waitForSearch();
+    void printPonderHitRate() const;
 
     Position board;
+    TranspositionTable tt;
+    Search::Worker searcher{ tt };
+    Mate::Solver mateSolver; // its table is allocated by the first "go mate"
+    int multiPV = 1;
+    std::thread searchThread; // runs the current "go", which reports its own bestmove
+    bool pondering = false;   // the running search is a "go ponder" without a ponderhit yet
+    bool infinite = false;    // the running search is a "go infinite", which waits for "stop"
+    uint64_t ponderSearches = 0;
+    uint64_t ponderHits = 0;
+    bool debug = false;
+    std::string commandLine;
 };
 
-} // namespace Zugzwang
\ No newline at end of file
+namespace UCI {
+
+// Sets up pos from the arguments of a "position" command, e.g. "startpos moves e2e4". An invalid
+// FEN is reported on os and leaves pos at the start position.
+bool SetPosition(Position& pos, std::string_view args, std::ostream& os);
+
+// Returns the move in coordinate notation, or Move::None() if it is not a pseudo-legal move
+Move ParseMove(const Position& pos, std::string_view str);
+
+// Coordinate notation, e.g. "e2e4" or "e7e8q"
+std::string FormatMove(Move move);
+
+// "cp <centipawns>" or "mate <moves>", negative when the side to move is getting mated
+std::string FormatScore(int score);
+
+} // namespace UCI
+
+} // namespace Zugzwang
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "zugzwang.h"
+#include "bitboard.h"
+#include "movegen.h"
+#include "position.h"
+#include <new>
+
+using namespace Zugzwang;
+
+struct zz_position {
+    Position pos;
+    int plies = 0; // moves made and not yet unmade
+};
+
+namespace {
+
+static_assert(ZZ_MAX_MOVES == MAX_MOVES);
+static_assert(ZZ_MAX_PLIES < MAX_PLIES - 1, "a legality test makes one more move");
+static_assert(std::is_same_v<zz_move, uint16_t> && sizeof(Move) == sizeof(zz_move));
+
+// The tables shared by all positions, set up by the first one created
+void init() {
+    static const bool done = [] {
+        Bitboards::Init();
+        Position::Init();
+        return true;
+    }();
+    (void)done;
+}
+
+bool setFen(zz_position* p, const char* fen) {
+    p->plies = 0;
+    if (p->pos.ParseFen(fen ? fen : StartFEN)) {
+        return true;
+    }
+    p->pos.ParseFen(StartFEN);
+    return false;
+}
+
+} // namespace
+
+extern "C" {
+
+int zz_api_version(void) { return ZZ_API_VERSION; }
+
+zz_position* zz_position_new(const char* fen) {
+    init();
+
+    zz_position* p = new (std::nothrow) zz_position;
+    if (p && !setFen(p, fen)) {
+        delete p;
+        return nullptr;
+    }
+    return p;
+}
+
+void zz_position_free(zz_position* pos) { delete pos; }
+
+int zz_position_set_fen(zz_position* pos, const char* fen) { return setFen(pos, fen) ? 0 : -1; }
+
+size_t zz_position_fen(const zz_position* pos, char* buffer, size_t size) {
+    const std::string fen = pos->pos.Fen();
+    if (fen.size() < size) {
+        std::memcpy(buffer, fen.c_str(), fen.size() + 1);
+    }
+    return fen.size();
+}
+
+uint64_t zz_position_hash(const zz_position* pos) { return pos->pos.PosKey(); }
+
+int zz_position_in_check(const zz_position* pos) { return pos->pos.Checkers() != 0; }
+
+int zz_legal_moves(zz_position* pos, zz_move* moves, int capacity) {
+    MoveList list;
+    MoveGen::GeneratePseudo(pos->pos, list);
+
+    int count = 0;
+    for (const auto move : list) {
+        if (pos->pos.MakeMove(move)) {
+            pos->pos.UnmakeMove(move);
+            if (count < capacity) {
+                moves[count] = move.Raw();
+            }
+            ++count;
+        }
+    }
+    return count;
+}
+
+int zz_make_move(zz_position* pos, zz_move move) {
+    // Anything else could corrupt the board
+    if (pos->plies >= ZZ_MAX_PLIES || !pos->pos.IsLegal(Move(move))) {
+        return -1;
+    }
+    pos->pos.MakeMove(Move(move));
+    ++pos->plies;
+    return 0;
+}
+
+void zz_unmake_move(zz_position* pos, zz_move move) {
+    assert(pos->plies > 0);
+    pos->pos.UnmakeMove(Move(move));
+    --pos->plies;
+}
+
+uint64_t zz_perft(zz_position* pos, int depth) {
+    if (pos->plies + depth > ZZ_MAX_PLIES) {
+        return 0;
+    }
+    return pos->pos.Perft(std::max(depth, 0));
+}
+
+void zz_move_to_uci(zz_move move, char* buffer) {
+    const Move m(move);
+    if (!m) {
+        std::memcpy(buffer, "0000", 5);
+        return;
+    }
+
+    const Square from = m.FromSq();
+    const Square to = m.ToSq();
+    *buffer++ = char('a' + FileOf(from));
+    *buffer++ = char('1' + RankOf(from));
+    *buffer++ = char('a' + FileOf(to));
+    *buffer++ = char('1' + RankOf(to));
+    if (m.TypeOf() == PROMOTION) {
+        *buffer++ = " nbrq"[m.PromotionType() - PAWN];
+    }
+    *buffer = '\0';
+}
+
+zz_move zz_move_from_uci(zz_position* pos, const char* uci) {
+    zz_move moves[ZZ_MAX_MOVES];
+    const int count = zz_legal_moves(pos, moves, ZZ_MAX_MOVES);
+
+    char buffer[6];
+    for (int i = 0; i < count; ++i) {
+        zz_move_to_uci(moves[i], buffer);
+        if (std::strcmp(buffer, uci) == 0) {
+            return moves[i];
+        }
+    }
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,96 @@
+/*
+ * C interface to the Zugzwang board, for programs that want move generation in process rather
+ * than over UCI. Link libzugzwang (static or shared); the engine's C++ headers are not needed.
+ *
+ * Functions taking a zz_position are not thread-safe for the same position, different positions
+ * may be used from different threads. None of them print anything.
+ */
+#ifndef ZUGZWANG_H
+#define ZUGZWANG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Only these functions are exported from the shared library */
+#if defined(__GNUC__)
+#define ZZ_API __attribute__((visibility("default")))
+#else
+#define ZZ_API
+#endif
+
+/* Bumped whenever a signature or the move encoding changes */
+#define ZZ_API_VERSION 1
+
+/* Enough for every position */
+#define ZZ_MAX_MOVES 256
+
+/* Moves that may be made on a position and not yet unmade */
+#define ZZ_MAX_PLIES 2000
+
+/* Long enough for any FEN this library returns, terminator included */
+#define ZZ_FEN_MAX 128
+
+typedef struct zz_position zz_position;
+
+/*
+ * 16 bits:
+ * bit  0- 5: destination square, a1 = 0, b1 = 1, ..., h8 = 63 (the king's for castling)
+ * bit  6-11: origin square
+ * bit 12-13: promotion piece: knight (0), bishop (1), rook (2), queen (3)
+ * bit 14-15: normal (0), promotion (1), en passant (2), castling (3)
+ * Zero is never a legal move.
+ */
+typedef uint16_t zz_move;
+
+ZZ_API int zz_api_version(void);
+
+/* NULL for the start position. Returns NULL if the FEN is invalid or memory runs out. */
+ZZ_API zz_position* zz_position_new(const char* fen);
+ZZ_API void zz_position_free(zz_position* pos);
+
+/* Returns 0, or -1 if the FEN is invalid, which leaves the start position */
+ZZ_API int zz_position_set_fen(zz_position* pos, const char* fen);
+
+/* Writes the FEN with its terminator if it fits in size bytes. Returns its length either way. */
+ZZ_API size_t zz_position_fen(const zz_position* pos, char* buffer, size_t size);
+
+/* The position key, the same for the same board, side to move, castling and en passant square */
+ZZ_API uint64_t zz_position_hash(const zz_position* pos);
+
+/* Nonzero if the side to move is in check */
+ZZ_API int zz_position_in_check(const zz_position* pos);
+
+/*
+ * Writes up to capacity legal moves to moves, in the engine's generation order, and returns how
+ * many legal moves there are. A buffer of ZZ_MAX_MOVES always suffices.
+ */
+ZZ_API int zz_legal_moves(zz_position* pos, zz_move* moves, int capacity);
+
+/*
+ * Plays a move returned by zz_legal_moves() for the current position. Returns 0, or -1 if the move
+ * is not legal here, which leaves the position unchanged. At most ZZ_MAX_PLIES moves can be made
+ * before they are unmade.
+ */
+ZZ_API int zz_make_move(zz_position* pos, zz_move move);
+
+/* Takes back the last move made, which must be given again */
+ZZ_API void zz_unmake_move(zz_position* pos, zz_move move);
+
+/* The number of leaf nodes depth plies below the position, 0 if that would go past ZZ_MAX_PLIES */
+ZZ_API uint64_t zz_perft(zz_position* pos, int depth);
+
+/* Coordinate notation such as "e2e4" or "e7e8q" into a buffer of at least 6 bytes */
+ZZ_API void zz_move_to_uci(zz_move move, char* buffer);
+
+/* The legal move of the position in coordinate notation, or 0 if there is none */
+ZZ_API zz_move zz_move_from_uci(zz_position* pos, const char* uci);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZUGZWANG_H */
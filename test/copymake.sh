@@ -0,0 +1,32 @@
+#!/bin/bash
+# build the make/unmake and copy-make Position modes and compare their perft speed
+
+TESTS_FAILED=0
+
+echo "copy-make testing started"
+
+for copy_make in OFF ON; do
+  build_dir="build-copymake-$copy_make"
+
+  if ! cmake -S . -B "$build_dir" -DCMAKE_BUILD_TYPE=Release -DZUGZWANG_COPY_MAKE=$copy_make > /dev/null ||
+     ! cmake --build "$build_dir" > /dev/null; then
+    echo "ZUGZWANG_COPY_MAKE=$copy_make: build FAILED"
+    TESTS_FAILED=1
+    continue
+  fi
+
+  output=$("./$build_dir/Zugzwang" bench makemove && "./$build_dir/Zugzwang" bench perft)
+  echo "$output"
+
+  if echo "$output" | grep -q "Perft mismatch"; then
+    echo "ZUGZWANG_COPY_MAKE=$copy_make: FAILED"
+    TESTS_FAILED=1
+  fi
+done
+
+echo "copy-make testing completed"
+
+if [ $TESTS_FAILED -ne 0 ]; then
+  echo "Some tests failed"
+  exit 1
+fi
@@ -0,0 +1,53 @@
+#!/bin/bash
+# compare distributed perft with the single process divide, from scratch and from a checkpoint
+
+TESTS_FAILED=0
+
+echo "distributed perft testing started"
+
+CHECKPOINT=$(mktemp)
+
+# the divide and total lines, without the timing
+perft_lines() {
+  grep -E "^([a-h][1-8]){2}[nbrq]?: |^Total: " | sed 's/ in [0-9]* ms//'
+}
+
+run_test() {
+  local pos="$1"
+  local depth="$2"
+
+  echo -n "Testing depth $depth: ${pos:0:40}... "
+
+  local expected=$(printf "position %s\ngo perft %s\nquit\n" "$pos" "$depth" | ./build/Zugzwang |
+    perft_lines)
+
+  rm -f "$CHECKPOINT"
+  local fresh=$(printf "position %s\ndistperft %s workers 3 checkpoint %s\nquit\n" \
+    "$pos" "$depth" "$CHECKPOINT" | ./build/Zugzwang | perft_lines)
+
+  # keep half of the checkpoint, cutting its last line short as a crash would
+  head -c $(( $(stat -c %s "$CHECKPOINT") / 2 )) "$CHECKPOINT" > "$CHECKPOINT.half"
+  mv "$CHECKPOINT.half" "$CHECKPOINT"
+  local resumed=$(printf "position %s\ndistperft %s workers 2 checkpoint %s\nquit\n" \
+    "$pos" "$depth" "$CHECKPOINT" | ./build/Zugzwang | perft_lines)
+
+  if [ -n "$expected" ] && [ "$fresh" == "$expected" ] && [ "$resumed" == "$expected" ]; then
+    echo "OK"
+  else
+    echo "FAILED"
+    TESTS_FAILED=1
+  fi
+}
+
+run_test "startpos" 5
+run_test "fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -" 4
+run_test "fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -" 6
+run_test "fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" 4
+
+rm -f "$CHECKPOINT"
+echo "distributed perft testing completed"
+
+if [ $TESTS_FAILED -ne 0 ]; then
+  echo "Some tests failed"
+  exit 1
+fi
@@ -0,0 +1,14 @@
+#!/bin/bash
+# check Position::IsPseudoLegal() and IsLegal() against the move generator on random positions
+
+echo "legality testing started"
+
+output=$(./build/Zugzwang bench legality)
+echo "$output"
+
+echo "legality testing completed"
+
+if ! echo "$output" | grep -q "Legality test: passed"; then
+  echo "Some tests failed"
+  exit 1
+fi
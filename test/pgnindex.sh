@@ -0,0 +1,97 @@
+#!/bin/bash
+# index a small PGN with the SAN cases that need care and check what the index gives back
+
+TESTS_FAILED=0
+
+echo "pgnindex testing started"
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+cat << 'EOF_PGN' > "$dir/games.pgn"
+[Event "Castling"]
+[Result "1-0"]
+
+1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 1-0
+
+[Event "Comments, variations and NAGs"]
+[Result "1/2-1/2"]
+
+1. e4 c5 {Sicilian (with a paren} 2. Nf3 (2. c3 d5 (2... Nf6) 3. exd5) d6 3.d4 cxd4
+4. Nxd4 Nf6 5. Nc3 a6 $1 ; Najdorf
+1/2-1/2
+
+[Event "Result from the tag"]
+[Result "0-1"]
+
+1. d4 d5 2. c4 e6
+
+[Event "En passant and promotion"]
+[SetUp "1"]
+[FEN "4k3/8/8/3pP3/8/8/1p6/4K3 w - d6 0 1"]
+[Result "0-1"]
+
+1. exd6 e.p. b1=Q+ 2. Kd2 Qb4+ 0-1
+
+[Event "Disambiguation"]
+[SetUp "1"]
+[FEN "4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1"]
+[Result "1-0"]
+
+1. R1a3 Kd7 2. Nfd2 Kc7 1-0
+
+[Event "Long castling"]
+[SetUp "1"]
+[FEN "r3k3/8/8/8/8/8/8/4K3 b q - 0 1"]
+[Result "1/2-1/2"]
+
+1... O-O-O 2. Kf2 1/2-1/2
+
+[Event "Unfinished"]
+[Result "*"]
+
+1. e4 e5 *
+
+[Event "Illegal move"]
+[Result "1-0"]
+
+1. e4 Ke7 1-0
+EOF_PGN
+
+output=$(./build/Zugzwang << EOF_UCI
+pgnindex $dir/games.pgn threads 2
+pgnprobe $dir/games.pgn.idx
+position startpos moves e2e4
+pgnprobe $dir/games.pgn.idx
+position fen 4k3/8/8/3pP3/8/8/1p6/4K3 w - d6 0 1 moves e5d6
+pgnprobe $dir/games.pgn.idx
+position fen 4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1 moves a1a3 e8d7
+pgnprobe $dir/games.pgn.idx
+position fen r3k3/8/8/8/8/8/8/4K3 b q - 0 1
+pgnprobe $dir/games.pgn.idx
+quit
+EOF_UCI
+)
+echo "$output"
+
+for expected in "Replayed 6 games (2 skipped)" \
+                "3 games, 2 moves" \
+                "e2e4 games 2 +1 =1 -0" \
+                "d2d4 games 1 +0 =0 -1" \
+                "e7e5 games 1 +0 =0 -1" \
+                "c7c5 games 1 +0 =1 -0" \
+                "b2b1q games 1 +1 =0 -0" \
+                "f1d2 games 1 +1 =0 -0" \
+                "e8c8 games 1 +0 =1 -0"; do
+  if ! echo "$output" | grep -qF "$expected"; then
+    echo "missing: $expected"
+    TESTS_FAILED=1
+  fi
+done
+
+echo "pgnindex testing completed"
+
+if [ $TESTS_FAILED -ne 0 ]; then
+  echo "Some tests failed"
+  exit 1
+fi
@@ -0,0 +1,35 @@
+#!/bin/bash
+# check that a second process finds the search of a first one in a shared hash segment
+
+SEGMENT="zugzwang-test-$$"
+
+echo "shared hash testing started"
+
+# nodes of the depth 10 iteration, the "# wait" comment holds "quit" back until the search is done
+search_nodes() {
+  { printf "setoption name SharedHash value %s\n" "$1"
+    printf "position startpos moves e2e4 e7e5\ngo depth 10\n# wait\nquit\n"; } |
+    ./build/Zugzwang | grep "^info depth 10 " | sed 's/.* nodes \([0-9]*\) .*/\1/'
+}
+
+first=$(search_nodes "$SEGMENT")
+second=$(search_nodes "$SEGMENT")
+private=$(search_nodes "<empty>")
+
+printf "setoption name SharedHash value %s\nsetoption name Remove SharedHash\nquit\n" "$SEGMENT" |
+  ./build/Zugzwang > /dev/null
+removed=yes
+if [ -e "/dev/shm/$SEGMENT" ]; then
+  removed=no
+  rm -f "/dev/shm/$SEGMENT"
+fi
+
+echo "nodes to depth 10: first process $first, second process $second, private table $private"
+echo "segment removed: $removed"
+echo "shared hash testing completed"
+
+if [ -z "$first" ] || [ -z "$second" ] || [ "$private" != "$first" ] ||
+   [ "$second" -ge "$first" ] || [ "$removed" != yes ]; then
+  echo "Some tests failed"
+  exit 1
+fi
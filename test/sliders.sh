@@ -0,0 +1,32 @@
+#!/bin/bash
+# build every slider attack backend, check it against the reference ray walk and compare perft speed
+
+TESTS_FAILED=0
+
+echo "slider backend testing started"
+
+for backend in MAGIC HYPERBOLA OBSTRUCTION KOGGE_STONE; do
+  build_dir="build-sliders-$backend"
+
+  if ! cmake -S . -B "$build_dir" -DCMAKE_BUILD_TYPE=Release -DZUGZWANG_SLIDERS=$backend > /dev/null ||
+     ! cmake --build "$build_dir" > /dev/null; then
+    echo "$backend: build FAILED"
+    TESTS_FAILED=1
+    continue
+  fi
+
+  output=$("./$build_dir/Zugzwang" bench sliders)
+  echo "$output"
+
+  if ! echo "$output" | grep -q "Equivalence test: passed" || echo "$output" | grep -q "Perft mismatch"; then
+    echo "$backend: FAILED"
+    TESTS_FAILED=1
+  fi
+done
+
+echo "slider backend testing completed"
+
+if [ $TESTS_FAILED -ne 0 ]; then
+  echo "Some tests failed"
+  exit 1
+fi
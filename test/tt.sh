@@ -0,0 +1,14 @@
+#!/bin/bash
+# check that the transposition table does not find keys that were never stored
+
+echo "hash table testing started"
+
+output=$(./build/Zugzwang bench tt)
+echo "$output"
+
+echo "hash table testing completed"
+
+if ! echo "$output" | grep -q "Hash table test: passed"; then
+  echo "Some tests failed"
+  exit 1
+fi